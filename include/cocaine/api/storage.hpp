@@ -36,6 +36,23 @@ namespace cocaine { namespace api {
 struct storage_t {
     typedef storage_t category_type;
 
+    // Incremental writer for the values too large to be passed around in one piece. The value is
+    // stored only once it's committed, an abandoned writer leaves the storage intact.
+    struct writer_t {
+        virtual
+       ~writer_t() {
+            // Empty.
+        }
+
+        virtual
+        void
+        write(const std::string& chunk) = 0;
+
+        virtual
+        void
+        commit() = 0;
+    };
+
     virtual
    ~storage_t() {
         // Empty.
@@ -58,6 +75,14 @@ struct storage_t {
     std::vector<std::string>
     find(const std::string& collection, const std::vector<std::string>& tags) = 0;
 
+    // NOTE: The default writer buffers the whole value and stores it with write() on commit, the
+    // backends should override it to store the chunks as they come.
+
+    virtual
+    std::unique_ptr<writer_t>
+    open(const std::string& collection, const std::string& key,
+         const std::vector<std::string>& tags);
+
     // Helper methods
 
     template<class T>
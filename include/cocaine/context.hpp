@@ -56,9 +56,15 @@ class context_t {
     // storages or isolates, have to be declared after this one.
     std::unique_ptr<api::repository_t> m_repository;
 
+    // Memory held by the I/O streams of all the execution units.
+    std::shared_ptr<io::memory_budget_t> m_memory;
+
     // A pool of execution units - threads responsible for doing all the service invocations.
     std::vector<std::unique_ptr<execution_unit_t>> m_pool;
 
+    // Busy-polling execution units, reserved for the services which explicitly ask for them.
+    std::vector<std::unique_ptr<execution_unit_t>> m_polling;
+
     // Services are stored as a vector of pairs to preserve the initialization order. Synchronized,
     // because services are allowed to start and stop other services during their lifetime.
     synchronized<service_list_t> m_services;
@@ -107,7 +113,14 @@ public:
     // Network I/O
 
     auto
-    engine() -> execution_unit_t&;
+    engine(bool polling = false) -> execution_unit_t&;
+
+    auto
+    engines(bool polling = false) const -> const std::vector<std::unique_ptr<execution_unit_t>>&;
+
+    // Process-wide I/O memory budget, the execution units' budgets are charged against it.
+    auto
+    memory() const -> const std::shared_ptr<io::memory_budget_t>&;
 
 private:
     void
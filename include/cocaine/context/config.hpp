@@ -37,6 +37,115 @@ struct config_t {
     int
     versions();
 
+public:
+    struct transport_t {
+        // Maximum number of bytes gathered from the messages written to a session during one
+        // reactor turn before they are flushed with a single write. Zero disables coalescing.
+        size_t coalesce;
+
+        // Read incoming frames into a double-mapped ring buffer, so that partially received frames
+        // never have to be moved to the beginning of the buffer.
+        bool mirrored;
+
+        // Maximum number of outbound bytes queued for a session and the action taken once the
+        // queue goes over it. Zero disables the limit.
+        size_t limit;
+        io::overflow_policies overflow;
+
+        // Accept connections on every execution unit via separate SO_REUSEPORT acceptors instead of
+        // the service's own acceptor thread, letting the kernel balance them.
+        bool reuseport;
+
+        // Attach the connections to the busy-polling execution units, see polling_t.
+        bool polling;
+
+        // Overrides the maximum incoming frame size, unless it's zero.
+        size_t max_frame_size;
+
+        // Seconds after which the connections are dropped if nothing has been received from the
+        // client, or if the client hasn't read any of the outbound messages. Zero disables either.
+        size_t read_idle;
+        size_t write_idle;
+
+        // Seconds of outbound silence after which a heartbeat frame is sent to the client, so that
+        // it could tell a quiet connection from a dead one. Zero disables heartbeats.
+        size_t heartbeat;
+
+        // Outbound messages larger than this are sent in fragments of this size, interleaved with
+        // the other messages, to the clients which have asked for it. Zero disables interleaving.
+        size_t interleave;
+
+        // Capacity in bytes of the shared memory rings offered to the local clients of the service
+        // connected over its unix socket, see shared_channel_t. Zero disables the offer.
+        size_t shared;
+    };
+
+    typedef std::map<std::string, transport_t> transport_map_t;
+
+    // Asynchronous I/O backends of the execution units.
+    enum class backends {
+        // The reactor's own readiness notifications, i.e. epoll(7) on Linux.
+        reactor,
+        // io_uring(7), submitting the operations of all the sessions of a unit during a reactor
+        // turn with a single syscall. Units fall back to the reactor if the kernel lacks support.
+        uring
+    };
+
+    struct affinity_t {
+        // CPUs to pin execution units to, one CPU per unit in a round-robin fashion. Empty means
+        // the units are free to run on any CPU. With busy-polling units, every unit must get a CPU
+        // of its own.
+        std::vector<unsigned int> engines;
+
+        // CPUs to pin service acceptor threads to, as a whole set.
+        std::vector<unsigned int> services;
+
+        // Prefer allocating memory on the NUMA node the pinned CPUs belong to.
+        bool numa;
+    };
+
+    struct polling_t {
+        // Number of dedicated execution units which spin on their reactors instead of blocking in
+        // them. Only the services which ask for it in their transport options are attached there.
+        size_t pool;
+
+        // Microseconds of idle spinning after which a unit parks in its reactor until the next
+        // event. Zero means the units never park.
+        size_t spin;
+
+        // SO_BUSY_POLL value in microseconds for the TCP connections of these units, so that the
+        // kernel polls the device queue instead of waiting for an interrupt. Zero leaves it unset.
+        size_t busy_poll;
+    };
+
+    struct fairness_t {
+        // Maximum number of frames a session handles in one reactor turn before yielding to the
+        // other sessions of its execution unit.
+        size_t frames;
+
+        // Microseconds a session may spend handling frames in one reactor turn before yielding.
+        // Zero leaves only the frame limit.
+        size_t budget;
+    };
+
+    struct memory_t {
+        // Maximum number of bytes held in read buffers and outbound queues by a single execution
+        // unit and by all of them together. Once either is exceeded, the sessions holding the most
+        // memory are dropped. Zero disables the limit.
+        size_t engine;
+        size_t process;
+    };
+
+    // Policies to pick an execution unit for a new connection with.
+    enum class balancers {
+        // The least loaded unit by the mean CPU usage over the last minute, sampled every couple of
+        // seconds. Requires a full scan of the pool.
+        utilization,
+        // The less loaded of two random units by the live session count, outbound backlog and the
+        // reactor latency.
+        power_of_two
+    };
+
 public:
     struct {
         std::string plugins;
@@ -55,6 +164,32 @@ public:
         // I/O thread pool size.
         size_t pool;
 
+        // Execution unit selection policy for new connections.
+        balancers balancer;
+
+        // Session I/O backend.
+        backends backend;
+
+        // Minimal live load difference between two execution units for the busiest session of the
+        // more loaded one to be migrated to the other one. Zero disables migrations.
+        double rebalance;
+
+        // Thread placement for execution units and services.
+        affinity_t affinity;
+
+        // Busy-polling execution units for latency-critical services.
+        polling_t polling;
+
+        // Per-session share of an execution unit's reactor turns.
+        fairness_t fairness;
+
+        // Maximum size of an incoming frame in bytes. Clients sending larger frames are dropped as
+        // soon as the frame outgrows it, before it's buffered completely. Zero disables the limit.
+        size_t max_frame_size;
+
+        // I/O memory budgets.
+        memory_t memory;
+
         struct {
             // Pinned ports for static service port allocation.
             std::map<std::string, port_t> pinned;
@@ -62,6 +197,9 @@ public:
             // Port range to populate the dynamic port pool for service port allocation.
             std::tuple<port_t, port_t> shared;
         } ports;
+
+        // Per-service transport tuning. Services not listed here use the default transport options.
+        transport_map_t transports;
     } network;
 
     struct logging_t {
@@ -21,6 +21,7 @@
 #ifndef COCAINE_DEFAULTS_HPP
 #define COCAINE_DEFAULTS_HPP
 
+#include <cstddef>
 #include <string>
 
 namespace cocaine {
@@ -32,6 +33,7 @@ struct defaults {
 
     // Defaults for networking.
     static const std::string endpoint;
+    static const size_t max_frame_size;
 
     // Defaults for logging service.
     static const std::string log_verbosity;
@@ -0,0 +1,207 @@
+/*
+    Copyright (c) 2011-2014 Andrey Sibiryov <me@kobology.ru>
+    Copyright (c) 2011-2014 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef COCAINE_DETAIL_BLOCK_POOL_HPP
+#define COCAINE_DETAIL_BLOCK_POOL_HPP
+
+#include "cocaine/common.hpp"
+
+#include <atomic>
+#include <thread>
+
+namespace cocaine { namespace io {
+
+// Pool of fixed size memory blocks owned by a single thread. The owner thread allocates and frees
+// blocks without any synchronization, while other threads return the blocks they free to a
+// lock-free list, which is reclaimed by the owner thread in one go once its own list runs out.
+
+class block_pool_t {
+    COCAINE_DECLARE_NONCOPYABLE(block_pool_t)
+
+    struct block_t {
+        block_t* next;
+    };
+
+    std::atomic<std::thread::id> m_owner;
+
+    // Only touched by the owner thread.
+    block_t* m_local;
+    size_t m_idle;
+
+    std::atomic<block_t*> m_remote;
+
+public:
+    static const size_t kBlockSize = 256;
+
+    // Maximum number of idle blocks kept by the owner thread.
+    static const size_t kCapacity = 64;
+
+    block_pool_t():
+        m_owner(std::thread::id()),
+        m_local(nullptr),
+        m_idle(0),
+        m_remote(nullptr)
+    { }
+
+   ~block_pool_t() {
+        purge(m_local);
+        purge(m_remote.exchange(nullptr));
+    }
+
+    // NOTE: Until the owner is set, blocks are allocated with the global allocator and freed to the
+    // shared list, which is fine, as all the blocks have the same size.
+
+    void
+    owner(std::thread::id id) {
+        m_owner.store(id, std::memory_order_relaxed);
+    }
+
+    auto
+    allocate() -> void* {
+        if(!is_owner()) {
+            return ::operator new(kBlockSize);
+        }
+
+        if(!m_local) {
+            reclaim();
+        }
+
+        if(!m_local) {
+            return ::operator new(kBlockSize);
+        }
+
+        block_t* block = m_local;
+
+        m_local = block->next;
+        m_idle--;
+
+        return block;
+    }
+
+    void
+    deallocate(void* ptr) {
+        block_t* block = static_cast<block_t*>(ptr);
+
+        if(!is_owner()) {
+            block->next = m_remote.load(std::memory_order_relaxed);
+
+            while(!m_remote.compare_exchange_weak(block->next, block, std::memory_order_release,
+                std::memory_order_relaxed))
+            { }
+
+            return;
+        }
+
+        if(m_idle == kCapacity) {
+            return ::operator delete(ptr);
+        }
+
+        block->next = m_local;
+
+        m_local = block;
+        m_idle++;
+    }
+
+private:
+    bool
+    is_owner() const {
+        return m_owner.load(std::memory_order_relaxed) == std::this_thread::get_id();
+    }
+
+    void
+    reclaim() {
+        block_t* block = m_remote.exchange(nullptr, std::memory_order_acquire);
+
+        while(block) {
+            block_t* next = block->next;
+
+            deallocate(block);
+            block = next;
+        }
+    }
+
+    static
+    void
+    purge(block_t* block) {
+        while(block) {
+            block_t* next = block->next;
+
+            ::operator delete(block);
+            block = next;
+        }
+    }
+};
+
+// Allocator, which takes single objects which fit into a block from the pool. It's intended to be
+// used with std::allocate_shared(), so that the object and its control block are pooled together.
+
+template<class T>
+struct pooled {
+    typedef T value_type;
+
+    template<class U> friend struct pooled;
+
+    explicit
+    pooled(const std::shared_ptr<block_pool_t>& pool_):
+        pool(pool_)
+    { }
+
+    template<class U>
+    pooled(const pooled<U>& other):
+        pool(other.pool)
+    { }
+
+    T*
+    allocate(size_t n) {
+        if(n == 1 && sizeof(T) <= block_pool_t::kBlockSize) {
+            return static_cast<T*>(pool->allocate());
+        }
+
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void
+    deallocate(T* ptr, size_t n) {
+        if(n == 1 && sizeof(T) <= block_pool_t::kBlockSize) {
+            return pool->deallocate(ptr);
+        }
+
+        ::operator delete(ptr);
+    }
+
+    template<class U>
+    bool
+    operator==(const pooled<U>& other) const {
+        return pool == other.pool;
+    }
+
+    template<class U>
+    bool
+    operator!=(const pooled<U>& other) const {
+        return pool != other.pool;
+    }
+
+private:
+    std::shared_ptr<block_pool_t> pool;
+};
+
+}} // namespace cocaine::io
+
+#endif
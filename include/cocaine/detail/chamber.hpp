@@ -32,8 +32,45 @@
 
 #include <boost/thread/thread.hpp>
 
+#include <atomic>
+#include <chrono>
+
 namespace cocaine { namespace io {
 
+// Where a chamber's thread is allowed to run and allocate memory.
+struct affinity_t {
+    // CPUs the thread is pinned to. Empty means any CPU.
+    std::vector<unsigned int> cpus;
+
+    // Prefer allocating memory on the NUMA node the pinned CPUs belong to. Ignored if these CPUs
+    // span several nodes, in which case the default local allocation policy is kept.
+    bool numa;
+};
+
+// How a chamber's thread waits for events.
+struct polling_t {
+    // Spin on the reactor instead of blocking in it, trading CPU time for wakeup latency.
+    bool enabled;
+
+    // Idle spinning time after which the thread parks in the reactor until the next event. Zero
+    // means the thread never parks.
+    std::chrono::microseconds spin;
+};
+
+// Where a polling chamber's thread spends its time, in nanoseconds.
+struct polling_stats_t {
+    polling_stats_t(): working(0), spinning(0), parked(0) { }
+
+    // Running the handlers.
+    std::atomic<uint64_t> working;
+
+    // Polling the reactor without finding anything to do.
+    std::atomic<uint64_t> spinning;
+
+    // Blocked in the reactor after spinning for too long, including the handler which woke it up.
+    std::atomic<uint64_t> parked;
+};
+
 class chamber_t {
     class named_runnable_t;
     class stats_periodic_action_t;
@@ -46,6 +83,9 @@ class chamber_t {
     // Takes resource usage snapshots every kCollectInterval seconds.
     asio::deadline_timer cron;
 
+    // Updated by the thread only if it's polling.
+    polling_stats_t polling_stats;
+
     // This thread will run the reactor's event loop until terminated.
     std::unique_ptr<boost::thread> thread;
 
@@ -58,7 +98,8 @@ class chamber_t {
     synchronized<load_average_t> load_acc1;
 
 public:
-    chamber_t(const std::string& name, const std::shared_ptr<asio::io_service>& asio);
+    chamber_t(const std::string& name, const std::shared_ptr<asio::io_service>& asio,
+              const affinity_t& affinity = affinity_t(), const polling_t& polling = polling_t());
    ~chamber_t();
 
     auto
@@ -66,6 +107,11 @@ public:
         return boost::accumulators::rolling_mean(*load_acc1.synchronize());
     }
 
+    auto
+    polling() const -> const polling_stats_t& {
+        return polling_stats;
+    }
+
     std::string
     thread_id() const;
 };
@@ -25,6 +25,9 @@
 
 #include <asio/deadline_timer.hpp>
 
+#include <atomic>
+#include <chrono>
+
 namespace cocaine {
 
 class session_t;
@@ -35,12 +38,62 @@ class session;
 class execution_unit_t {
     COCAINE_DECLARE_NONCOPYABLE(execution_unit_t)
 
-    class gc_action_t;
+    class stats_action_t;
+    class probe_action_t;
+    class sweep_action_t;
+
+public:
+    // Counters of the sessions migrated away from an execution unit.
+    struct migration_stats_t {
+        migration_stats_t(): migrated(0), elapsed(0) { }
+
+        std::atomic<uint64_t> migrated;
+
+        // Total time from the migration requests to the sessions' arrival, in microseconds.
+        std::atomic<uint64_t> elapsed;
+    };
+
+private:
+    context_t& m_context;
+    const config_t& m_config;
+
+    // Whether this unit spins on its reactor, see config_t::polling_t.
+    const bool m_polling;
 
     // Connections
 
     std::map<int, std::shared_ptr<session_t>> m_sessions;
 
+    // Memory held by the sessions of this execution unit, charged to the process-wide budget too.
+    const std::shared_ptr<io::memory_budget_t> m_memory;
+
+    // Read buffers shared by all the sessions of this execution unit.
+    const std::shared_ptr<io::buffer_pool_t> m_buffers;
+
+    // Outbound queue overflow counters of all the sessions of this execution unit.
+    const std::shared_ptr<io::overflow_stats_t> m_overflows;
+
+    // Messages and write calls of all the sessions of this execution unit.
+    const std::shared_ptr<io::outbound_stats_t> m_outbound;
+
+    // Live load signals, readable from any thread without locking. The session count is updated
+    // right away when a connection is attached, while the memory held by the sessions and the
+    // reactor latency in microseconds are sampled every kProbeInterval milliseconds.
+    std::atomic<size_t> m_active;
+    std::atomic<size_t> m_backlog;
+    std::atomic<uint64_t> m_latency;
+
+    // Sessions dropped because the memory budget was exceeded.
+    uint64_t m_shed;
+
+    // Shared with the migrated sessions, as they might arrive after this unit is gone.
+    const std::shared_ptr<migration_stats_t> m_migrations;
+
+    // Sessions are scanned for a migration at most once per kMigrationInterval seconds.
+    static const unsigned int kMigrationInterval = 1;
+
+    std::chrono::steady_clock::time_point m_migrated;
+
     // I/O
 
     std::shared_ptr<asio::io_service> m_asio;
@@ -49,24 +102,89 @@ class execution_unit_t {
     // Initialized here because of the dependency on the io::chamber_t's thread ID.
     const std::unique_ptr<logging::logger_t> m_log;
 
-    static const unsigned int kCollectionInterval = 60;
+    static const unsigned int kStatsInterval = 60;
 
-    // Collects detached sessions every kCollectionInterval seconds. Normally, session slots will be
-    // reused because of system fd rotation, but for low loads this will help a bit.
+    // Reports the execution unit stats every kStatsInterval seconds. Detached sessions are not
+    // collected here, they're removed as soon as their connections are destroyed.
     std::unique_ptr<asio::deadline_timer> m_cron;
 
+    static const unsigned int kProbeInterval = 100;
+
+    std::unique_ptr<asio::deadline_timer> m_probe;
+
+    static const unsigned int kSweepInterval = 1;
+
+    // Checks all the sessions for idle timeouts and heartbeats every kSweepInterval seconds, so
+    // that the sessions don't need timers of their own.
+    std::unique_ptr<asio::deadline_timer> m_sweep;
+
 public:
-    explicit
-    execution_unit_t(context_t& context);
+    // The index is used to name the unit's thread and to pick a CPU for it to be pinned to.
+    execution_unit_t(context_t& context, size_t index, bool polling);
 
    ~execution_unit_t();
 
+    // NOTE: Sockets should be accepted or connected on the execution unit's reactor beforehand,
+    // otherwise they're cloned into it which costs a couple of extra syscalls.
     template<class Socket>
     std::shared_ptr<session<typename Socket::protocol_type>>
     attach(std::unique_ptr<Socket> ptr, const io::dispatch_ptr_t& dispatch);
 
     double
     utilization() const;
+
+    // Combined live load score, lower is better.
+    double
+    load() const;
+
+    bool
+    polling() const;
+
+    auto
+    asio() const -> asio::io_service&;
+
+    auto
+    buffers() const -> const io::buffer_pool_t&;
+
+    auto
+    memory() const -> const io::memory_budget_t&;
+
+    auto
+    overflows() const -> const io::overflow_stats_t&;
+
+    auto
+    outbound() const -> const io::outbound_stats_t&;
+
+    auto
+    migrations() const -> const migration_stats_t&;
+
+private:
+    // Registers the session in the connection table. Must be called on the execution unit thread.
+    void
+    insert(int fd, const std::shared_ptr<session_t>& session);
+
+    void
+    remove(int fd, const session_t* session);
+
+    // Drops the session holding the most memory. Scans all the sessions, so it's only called when
+    // the memory budget is exceeded, and at most once per probe, which gives the budget a chance
+    // to recover before the next session is picked.
+    void
+    shed();
+
+    // Returns the least loaded execution unit if a migration is due and the load imbalance is too
+    // high, nullptr otherwise.
+    auto
+    balance() -> execution_unit_t*;
+
+    // Migrates the busiest session to the execution unit returned by balance(). Scans all the
+    // sessions, so it's only called when a migration is due.
+    void
+    rebalance(execution_unit_t* target);
+
+    template<class Socket>
+    std::unique_ptr<Socket>
+    clone(Socket& socket);
 };
 
 } // namespace cocaine
@@ -32,6 +32,8 @@ struct storage_t:
     public api::service_t,
     public dispatch<io::storage_tag>
 {
+    class upload_slot_t;
+
     storage_t(context_t& context, asio::io_service& asio, const std::string& name, const dynamic_t& args);
 
     virtual
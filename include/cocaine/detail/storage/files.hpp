@@ -30,6 +30,8 @@ namespace cocaine { namespace storage {
 class files_t:
     public api::storage_t
 {
+    class upload_t;
+
     const std::unique_ptr<logging::logger_t> m_log;
 
     // Underlying storage access synchronization. Note that two or more runtime instances probably
@@ -60,6 +62,23 @@ public:
     virtual
     std::vector<std::string>
     find(const std::string& collection, const std::vector<std::string>& tags);
+
+    // Streams the chunks into a temporary file, which replaces the object on commit.
+    virtual
+    std::unique_ptr<writer_t>
+    open(const std::string& collection, const std::string& key,
+         const std::vector<std::string>& tags);
+
+private:
+    // NOTE: Both must be called with the mutex locked.
+
+    // Creates the collection directory if it doesn't exist yet.
+    auto
+    prepare(const std::string& collection) -> boost::filesystem::path;
+
+    void
+    link(const boost::filesystem::path& store_path, const std::string& key,
+         const std::vector<std::string>& tags);
 };
 
 }} // namespace cocaine::storage
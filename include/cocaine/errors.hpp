@@ -32,7 +32,10 @@ enum transport_errors {
     frame_format_error = 1,
     hpack_error,
     insufficient_bytes,
-    parse_error
+    parse_error,
+    outbound_overflow,
+    frame_too_large,
+    memory_budget_exceeded
 };
 
 enum dispatch_errors {
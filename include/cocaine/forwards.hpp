@@ -40,6 +40,7 @@ class logger_t;
 namespace cocaine {
 
 class context_t;
+struct config_t;
 
 template<class> class dispatch;
 template<class> class upstream;
@@ -68,12 +69,30 @@ class chamber_t;
 
 // I/O streams
 
+class block_pool_t;
+class buffer_pool_t;
+class memory_budget_t;
+
 template<class, class>
 class readable_stream;
 
 template<class, class>
 class writable_stream;
 
+// Outbound queue overflow policies
+
+enum class overflow_policies: int {
+    // Stop reading from the client until the queue is drained.
+    pause,
+    // Let the producers know via streamed<T>::congested().
+    signal,
+    // Drop the client.
+    disconnect
+};
+
+struct overflow_stats_t;
+struct outbound_stats_t;
+
 // Stream composition
 
 struct encoder_t;
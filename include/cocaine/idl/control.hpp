@@ -0,0 +1,97 @@
+/*
+    Copyright (c) 2011-2015 Andrey Sibiryov <me@kobology.ru>
+    Copyright (c) 2011-2015 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef COCAINE_CONTROL_INTERFACE_HPP
+#define COCAINE_CONTROL_INTERFACE_HPP
+
+#include "cocaine/rpc/protocol.hpp"
+
+namespace cocaine { namespace io {
+
+struct control_tag;
+
+// Connection control interface. Its messages are sent in the reserved channel zero, which is never
+// allocated for invocations, and are never dispatched to services.
+
+struct control {
+
+struct heartbeat {
+    typedef control_tag tag;
+
+    static const char* alias() {
+        return "heartbeat";
+    }
+
+    typedef void upstream_type;
+};
+
+// Sent by the clients which can reassemble fragmented messages, see fragment.
+struct interleave {
+    typedef control_tag tag;
+
+    static const char* alias() {
+        return "interleave";
+    }
+
+    typedef void upstream_type;
+};
+
+// A piece of an outbound message too large to be sent in one go. Fragments of different messages
+// are interleaved with each other and with the regular messages. The pieces with the same stream id
+// are concatenated in order into the original frame, which is complete with the last one.
+struct fragment {
+    typedef control_tag tag;
+
+    static const char* alias() {
+        return "fragment";
+    }
+
+    typedef boost::mpl::list<
+     /* Stream id, unique within the connection. */
+        uint64_t,
+     /* Whether it's the last fragment of the stream. */
+        bool,
+     /* Piece of the original frame. */
+        std::string
+    > argument_type;
+
+    typedef void upstream_type;
+};
+
+}; // struct control
+
+template<>
+struct protocol<control_tag> {
+    typedef boost::mpl::int_<
+        1
+    >::type version;
+
+    typedef boost::mpl::list<
+        control::heartbeat,
+        control::interleave,
+        control::fragment
+    >::type messages;
+
+    typedef control scope;
+};
+
+}} // namespace cocaine::io
+
+#endif
@@ -21,6 +21,7 @@
 #ifndef COCAINE_STORAGE_SERVICE_INTERFACE_HPP
 #define COCAINE_STORAGE_SERVICE_INTERFACE_HPP
 
+#include "cocaine/idl/streaming.hpp"
 #include "cocaine/rpc/protocol.hpp"
 
 namespace cocaine { namespace io {
@@ -73,6 +74,27 @@ struct write {
     >::type argument_type;
 };
 
+struct upload {
+    typedef storage_tag tag;
+
+    // The value is streamed in chunks of any size, which are stored as they come, and is committed
+    // once the stream is closed. Until then, the previous value is kept intact.
+    typedef stream_of<std::string>::tag dispatch_type;
+
+    static const char* alias() {
+        return "upload";
+    }
+
+    typedef boost::mpl::list<
+     /* Key namespace. */
+        std::string,
+     /* Key. */
+        std::string,
+     /* Tag list. */
+        optional<std::vector<std::string>>
+    >::type argument_type;
+};
+
 struct remove {
     typedef storage_tag tag;
 
@@ -122,7 +144,8 @@ struct protocol<storage_tag> {
         storage::read,
         storage::write,
         storage::remove,
-        storage::find
+        storage::find,
+        storage::upload
     >::type messages;
 
     typedef storage scope;
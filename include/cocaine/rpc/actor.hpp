@@ -32,6 +32,7 @@ class actor_t {
     COCAINE_DECLARE_NONCOPYABLE(actor_t)
 
     class accept_action_t;
+    class shard_action_t;
 
     context_t& m_context;
 
@@ -48,6 +49,11 @@ class actor_t {
     // allow concurrent observing and operations.
     synchronized<std::unique_ptr<asio::ip::tcp::acceptor>> m_acceptor;
 
+    // Per-engine SO_REUSEPORT acceptors, if enabled for this service. In this mode, the acceptor
+    // above only holds the port and never listens, and connections are accepted right on the
+    // execution units' threads.
+    std::vector<std::shared_ptr<asio::ip::tcp::acceptor>> m_shards;
+
     // Main service thread.
     std::unique_ptr<io::chamber_t> m_chamber;
 
@@ -78,6 +84,13 @@ public:
 
     void
     terminate();
+
+private:
+    void
+    spread(const asio::ip::tcp::endpoint& endpoint, bool polling);
+
+    void
+    retract();
 };
 
 } // namespace cocaine
@@ -0,0 +1,134 @@
+/*
+    Copyright (c) 2011-2014 Andrey Sibiryov <me@kobology.ru>
+    Copyright (c) 2011-2014 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef COCAINE_IO_BUFFER_POOL_HPP
+#define COCAINE_IO_BUFFER_POOL_HPP
+
+#include "cocaine/common.hpp"
+#include "cocaine/locked_ptr.hpp"
+
+#include "cocaine/rpc/asio/memory_budget.hpp"
+
+#include <atomic>
+
+namespace cocaine { namespace io {
+
+// Pool of read buffers shared by all the sessions of an execution unit. Sessions borrow a buffer only
+// while they have some bytes pending, so idle connections don't hold any buffer memory at all.
+//
+// NOTE: The pool charges its budget for the idle buffers only, the borrowed ones are charged by the
+// streams holding them, see readable_stream.
+
+class buffer_pool_t {
+    COCAINE_DECLARE_NONCOPYABLE(buffer_pool_t)
+
+public:
+    typedef std::vector<char, uninitialized<char>> buffer_type;
+
+    static const size_t kBufferSize = 65536;
+
+    // Maximum number of idle buffers kept in the pool. Buffers released over this limit are freed.
+    static const size_t kDefaultCapacity = 256;
+
+    explicit
+    buffer_pool_t(size_t capacity = kDefaultCapacity,
+                  const std::shared_ptr<memory_budget_t>& budget = nullptr)
+    :
+        m_capacity(capacity),
+        m_budget(budget),
+        m_borrowed(0)
+    { }
+
+   ~buffer_pool_t() {
+        if(m_budget) {
+            m_budget->discharge(m_buffers->size() * kBufferSize);
+        }
+    }
+
+    auto
+    acquire() -> buffer_type {
+        buffer_type buffer;
+
+        m_buffers.apply([&](std::vector<buffer_type>& buffers) {
+            if(!buffers.empty()) {
+                buffer = std::move(buffers.back());
+                buffers.pop_back();
+
+                if(m_budget) m_budget->discharge(kBufferSize);
+            }
+        });
+
+        if(buffer.empty()) {
+            buffer.resize(kBufferSize);
+        }
+
+        ++m_borrowed;
+
+        return buffer;
+    }
+
+    // Buffers which have grown larger than the default size to accomodate some huge frame are freed
+    // instead of being pooled, so that the memory is returned after such high-water frames.
+
+    void
+    release(buffer_type buffer) {
+        --m_borrowed;
+
+        if(buffer.size() != kBufferSize) {
+            return;
+        }
+
+        m_buffers.apply([&](std::vector<buffer_type>& buffers) {
+            if(buffers.size() < m_capacity) {
+                buffers.emplace_back(std::move(buffer));
+
+                if(m_budget) m_budget->charge(kBufferSize);
+            }
+        });
+    }
+
+    // Observers
+
+    auto
+    borrowed() const -> size_t {
+        return m_borrowed;
+    }
+
+    auto
+    idle() const -> size_t {
+        return m_buffers->size();
+    }
+
+    auto
+    budget() const -> const std::shared_ptr<memory_budget_t>& {
+        return m_budget;
+    }
+
+private:
+    const size_t m_capacity;
+    const std::shared_ptr<memory_budget_t> m_budget;
+
+    synchronized<std::vector<buffer_type>> m_buffers;
+    std::atomic<size_t> m_borrowed;
+};
+
+}} // namespace cocaine::io
+
+#endif
@@ -75,6 +75,145 @@ private:
     std::vector<hpack::header_t> metadata;
 };
 
+// Computes the length of the next msgpack frame without unpacking it. The scanning state is kept
+// between calls, so that a frame arriving in chunks is scanned only once. Raw bodies are skipped as
+// soon as their headers are available, even if the body itself hasn't been received yet.
+
+struct frame_scanner_t {
+    // Frames nested deeper than this are rejected right away.
+    static const size_t kMaxDepth = 128;
+
+    frame_scanner_t() {
+        reset();
+    }
+
+    // Returns true if the whole frame is available, its length is then reported by size().
+    bool
+    scan(const char* data, size_t size, std::error_code& ec) {
+        while(!stack.empty()) {
+            if(cursor >= size) {
+                return false;
+            }
+
+            const auto type = static_cast<unsigned char>(data[cursor]);
+
+            // Number of header bytes following the type byte.
+            size_t header = 0;
+            size_t body = 0;
+            size_t elements = 0;
+
+            // Whether the header contains the length of the body or the number of elements.
+            bool is_raw = false, is_container = false;
+
+            if(type <= 0x7f || type >= 0xe0 || (type >= 0xc0 && type <= 0xc3 && type != 0xc1)) {
+                // Fixed integers, nil and booleans.
+            } else if(type <= 0x8f) {
+                elements = (type & 0x0f) * 2;
+            } else if(type <= 0x9f) {
+                elements = type & 0x0f;
+            } else if(type <= 0xbf) {
+                body = type & 0x1f;
+            } else {
+                switch(type) {
+                case 0xc4: case 0xd9: header = 1; is_raw = true; break;
+                case 0xc5: case 0xda: header = 2; is_raw = true; break;
+                case 0xc6: case 0xdb: header = 4; is_raw = true; break;
+                case 0xc7: header = 1; body = 1; is_raw = true; break;
+                case 0xc8: header = 2; body = 1; is_raw = true; break;
+                case 0xc9: header = 4; body = 1; is_raw = true; break;
+                case 0xca: header = 4; break;
+                case 0xcb: header = 8; break;
+                case 0xcc: case 0xd0: header = 1; break;
+                case 0xcd: case 0xd1: header = 2; break;
+                case 0xce: case 0xd2: header = 4; break;
+                case 0xcf: case 0xd3: header = 8; break;
+                case 0xd4: body =  2; break;
+                case 0xd5: body =  3; break;
+                case 0xd6: body =  5; break;
+                case 0xd7: body =  9; break;
+                case 0xd8: body = 17; break;
+                case 0xdc: header = 2; is_container = true; break;
+                case 0xdd: header = 4; is_container = true; break;
+                case 0xde: header = 2; is_container = true; break;
+                case 0xdf: header = 4; is_container = true; break;
+                default:
+                    ec = error::parse_error;
+                    return false;
+                }
+            }
+
+            if(cursor + 1 + header > size) {
+                return false;
+            }
+
+            if(is_raw || is_container) {
+                uint64_t length = 0;
+
+                for(size_t i = 1; i <= header; ++i) {
+                    length = (length << 8) | static_cast<unsigned char>(data[cursor + i]);
+                }
+
+                if(is_raw) {
+                    body += length;
+                } else {
+                    elements = type >= 0xde ? length * 2 : length;
+                }
+            }
+
+            cursor += 1 + header + body;
+
+            --stack.back();
+
+            if(elements) {
+                if(stack.size() == kMaxDepth) {
+                    ec = error::parse_error;
+                    return false;
+                }
+
+                stack.push_back(elements);
+            }
+
+            while(!stack.empty() && stack.back() == 0) {
+                stack.pop_back();
+            }
+        }
+
+        // The last scanned element might be a raw body which is still being received.
+        return cursor <= size;
+    }
+
+    size_t
+    size() const {
+        return cursor;
+    }
+
+    // Lower bound of the frame length, known as soon as the headers are scanned, even if the frame
+    // hasn't been received yet. Every element left to scan takes at least one byte.
+    size_t
+    bound() const {
+        size_t result = cursor;
+
+        for(auto it = stack.begin(); it != stack.end(); ++it) {
+            result += *it;
+        }
+
+        return result;
+    }
+
+    void
+    reset() {
+        cursor = 0;
+        stack.assign(1, 1);
+    }
+
+private:
+    // Offset of the next element to scan, relative to the beginning of the frame.
+    size_t cursor;
+
+    // Number of elements left to scan on every nesting level.
+    std::vector<size_t> stack;
+};
+
 } // namespace aux
 
 struct decoder_t {
@@ -85,16 +224,32 @@ struct decoder_t {
 
     typedef aux::decoded_message_t message_type;
 
+    // NOTE: The data must always start at the beginning of the pending frame, because the decoder
+    // remembers how much of that frame has already been scanned.
+
     size_t
     decode(const char* data, size_t size, message_type& message, std::error_code& ec) {
         size_t offset = 0;
 
+        if(!scanner.scan(data, size, ec)) {
+            if(!ec) {
+                ec = error::insufficient_bytes;
+            } else {
+                scanner.reset();
+            }
+
+            return offset;
+        }
+
         // NOTE: We have to clear msgpack zone every decoding iteration to prevent memory leaking
         // for objects structure, because they have no way to notify about self-destruction. Hope
         // someday we migrate to v1.* and everything will be fine automatically.
         zone.clear();
 
-        msgpack::unpack_return rv = msgpack::unpack(data, size, &offset, &zone, &message.object);
+        // The frame is known to be complete at this point, so it is unpacked exactly once.
+        msgpack::unpack_return rv = msgpack::unpack(data, scanner.size(), &offset, &zone, &message.object);
+
+        scanner.reset();
 
         if(rv == msgpack::UNPACK_SUCCESS || rv == msgpack::UNPACK_EXTRA_BYTES) {
             if(message.object.type != msgpack::type::ARRAY || message.object.via.array.size < 3) {
@@ -122,9 +277,18 @@ struct decoder_t {
         return offset;
     }
 
+    // Minimal length of the frame being received, as declared by the headers scanned so far.
+    size_t
+    expected() const {
+        return scanner.bound();
+    }
+
 private:
     msgpack::zone zone;
 
+    // Scanning state of the pending frame.
+    aux::frame_scanner_t scanner;
+
     // HPACK HTTP/2.0 tables.
     hpack::header_table_t hpack_context;
 };
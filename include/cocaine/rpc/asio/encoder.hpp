@@ -33,7 +33,10 @@
 #include "cocaine/traits.hpp"
 #include "cocaine/traits/tuple.hpp"
 
+#include <asio/buffer.hpp>
+
 #include <cstring>
+#include <new>
 
 namespace cocaine { namespace io {
 
@@ -46,17 +49,39 @@ namespace aux {
 
 struct encoded_buffers_t {
     friend struct encoded_message_t;
+    friend struct io::encoder_t;
 
     static const size_t kInitialBufferSize = 2048;
 
+    // Raw bodies at least this large are referenced in place instead of being copied into the
+    // buffer, but only if they belong to one of the pinned message arguments.
+    static const size_t kReferenceThreshold = 16384;
+
+    // NOTE: The buffer memory is allocated on the first write, so that empty messages are cheap.
     encoded_buffers_t():
         offset(0)
-    {
-        vector.resize(kInitialBufferSize);
+    { }
+
+    // Prepares the buffer to be reused for another message, keeping the allocated memory.
+    void
+    reset() {
+        offset = 0;
+
+        segments.clear();
+        pinned.clear();
     }
 
     void
     write(const char* data, size_t size) {
+        if(size >= kReferenceThreshold && is_pinned(data, size)) {
+            segments.emplace_back(offset, asio::const_buffer(data, size));
+            return;
+        }
+
+        if(vector.empty()) {
+            vector.resize(kInitialBufferSize);
+        }
+
         while(size > vector.size() - offset) {
             vector.resize(vector.size() * 2);
         }
@@ -66,6 +91,16 @@ struct encoded_buffers_t {
         offset += size;
     }
 
+    // Marks the memory region as stable for the lifetime of the encoded message, i.e. owned by the
+    // unbound message which outlives its encoded representation.
+
+    void
+    pin(const char* data, size_t size) {
+        if(size >= kReferenceThreshold) {
+            pinned.emplace_back(data, size);
+        }
+    }
+
     // Movable
 
     encoded_buffers_t(encoded_buffers_t&&) = default;
@@ -75,14 +110,38 @@ struct encoded_buffers_t {
 
     COCAINE_DECLARE_NONCOPYABLE(encoded_buffers_t)
 
+private:
+    bool
+    is_pinned(const char* data, size_t size) const {
+        for(auto it = pinned.begin(); it != pinned.end(); ++it) {
+            if(data >= it->first && data + size <= it->first + it->second) return true;
+        }
+
+        return false;
+    }
+
 private:
     std::vector<char, uninitialized<char>> vector;
     std::vector<char, uninitialized<char>>::size_type offset;
+
+    // Referenced raw bodies along with their insertion offsets in the packed buffer.
+    std::vector<std::pair<size_t, asio::const_buffer>> segments;
+    std::vector<std::pair<const char*, size_t>> pinned;
 };
 
 struct encoded_message_t {
     friend struct io::encoder_t;
 
+    encoded_message_t() = default;
+
+    explicit
+    encoded_message_t(encoded_buffers_t&& buffer_):
+        buffer(std::move(buffer_))
+    { }
+
+    // NOTE: For messages with referenced segments, this is only the leading part of the message,
+    // use buffers() to get the whole scatter-gather sequence.
+
     auto
     data() const -> const char* {
         return buffer.vector.data();
@@ -90,20 +149,216 @@ struct encoded_message_t {
 
     size_t
     size() const {
-        return buffer.offset;
+        size_t result = buffer.offset;
+
+        for(auto it = buffer.segments.begin(); it != buffer.segments.end(); ++it) {
+            result += asio::buffer_size(it->second);
+        }
+
+        return result;
+    }
+
+    // Number of buffers in the scatter-gather sequence.
+    size_t
+    count() const {
+        return buffer.segments.size() * 2 + 1;
+    }
+
+    template<class OutputIterator>
+    void
+    buffers(OutputIterator it) const {
+        size_t position = 0;
+
+        for(auto segment = buffer.segments.begin(); segment != buffer.segments.end(); ++segment) {
+            *it++ = asio::const_buffer(buffer.vector.data() + position, segment->first - position);
+            *it++ = segment->second;
+
+            position = segment->first;
+        }
+
+        *it++ = asio::const_buffer(buffer.vector.data() + position, buffer.offset - position);
     }
 
 private:
     encoded_buffers_t buffer;
 };
 
-struct unbound_message_t {
-    typedef std::function<aux::encoded_message_t(encoder_t&)> function_type;
+template<class T>
+inline
+void
+pin(encoded_buffers_t& COCAINE_UNUSED_(buffer), const T& COCAINE_UNUSED_(argument)) {
+    // Only strings are referenced by the encoder.
+}
+
+inline
+void
+pin(encoded_buffers_t& buffer, const std::string& argument) {
+    buffer.pin(argument.data(), argument.size());
+}
+
+inline
+void
+pin_arguments(encoded_buffers_t& COCAINE_UNUSED_(buffer)) {
+    // Empty.
+}
+
+template<class Head, class... Tail>
+inline
+void
+pin_arguments(encoded_buffers_t& buffer, const Head& head, const Tail&... tail) {
+    pin(buffer, head);
+    pin_arguments(buffer, tail...);
+}
+
+// NOTE: Encoded messages might reference the arguments stored in the unbound message, so the latter
+// must outlive the former, i.e. be kept alive until the write completion handler is invoked. Moving
+// the unbound message is fine, as only the heap allocated string bodies are ever referenced.
+
+class unbound_message_t {
+    struct vtable_t {
+        encoded_message_t (*encode)(void* function, encoder_t& encoder);
+        void (*move)(void* target, void* source);
+        void (*destroy)(void* function);
+    };
+
+    template<class F, bool Inline>
+    struct erasure;
+
+public:
+    // Partially applied message encoding functions up to this size are stored inline, so that the
+    // messages with a couple of small arguments don't allocate any memory.
+    static const size_t kInlineSize = 128;
+
+    unbound_message_t():
+        vtable(nullptr)
+    { }
+
+    template<class F>
+    explicit
+    unbound_message_t(F&& function) {
+        typedef typename std::decay<F>::type function_type;
+
+        typedef erasure<
+            function_type,
+            sizeof(function_type) <= kInlineSize &&
+                std::is_nothrow_move_constructible<function_type>::value
+        > erasure_type;
+
+        erasure_type::construct(&storage, std::forward<F>(function));
+        vtable = &erasure_type::vtable;
+    }
+
+    unbound_message_t(unbound_message_t&& other):
+        vtable(other.vtable)
+    {
+        if(vtable) vtable->move(&storage, &other.storage);
+        other.vtable = nullptr;
+    }
+
+    unbound_message_t&
+    operator=(unbound_message_t&& other) {
+        if(this != &other) {
+            reset();
+
+            if((vtable = other.vtable) != nullptr) vtable->move(&storage, &other.storage);
+            other.vtable = nullptr;
+        }
+
+        return *this;
+    }
+
+   ~unbound_message_t() {
+        reset();
+    }
+
+    COCAINE_DECLARE_NONCOPYABLE(unbound_message_t)
+
+    auto
+    encode(encoder_t& encoder) -> encoded_message_t {
+        return vtable->encode(&storage, encoder);
+    }
+
+private:
+    void
+    reset() {
+        if(vtable) vtable->destroy(&storage);
+        vtable = nullptr;
+    }
+
+private:
+    typename std::aligned_storage<kInlineSize>::type storage;
+    const vtable_t* vtable;
+};
+
+template<class F>
+struct unbound_message_t::erasure<F, true> {
+    template<class Function>
+    static
+    void
+    construct(void* storage, Function&& function) {
+        new(storage) F(std::forward<Function>(function));
+    }
+
+    static
+    encoded_message_t
+    encode(void* function, encoder_t& encoder) {
+        return (*static_cast<F*>(function))(encoder);
+    }
+
+    static
+    void
+    move(void* target, void* source) {
+        new(target) F(std::move(*static_cast<F*>(source)));
+        destroy(source);
+    }
+
+    static
+    void
+    destroy(void* function) {
+        static_cast<F*>(function)->~F();
+    }
+
+    static const vtable_t vtable;
+};
+
+template<class F>
+const unbound_message_t::vtable_t unbound_message_t::erasure<F, true>::vtable = {
+    &encode, &move, &destroy
+};
+
+template<class F>
+struct unbound_message_t::erasure<F, false> {
+    template<class Function>
+    static
+    void
+    construct(void* storage, Function&& function) {
+        new(storage) F*(new F(std::forward<Function>(function)));
+    }
+
+    static
+    encoded_message_t
+    encode(void* function, encoder_t& encoder) {
+        return (**static_cast<F**>(function))(encoder);
+    }
+
+    static
+    void
+    move(void* target, void* source) {
+        new(target) F*(*static_cast<F**>(source));
+    }
+
+    static
+    void
+    destroy(void* function) {
+        delete *static_cast<F**>(function);
+    }
 
-    // Partially applied message encoding function.
-    const function_type bind;
+    static const vtable_t vtable;
+};
 
-    unbound_message_t(function_type&& bind_): bind(std::move(bind_)) { }
+template<class F>
+const unbound_message_t::vtable_t unbound_message_t::erasure<F, false>::vtable = {
+    &encode, &move, &destroy
 };
 
 } // namespace aux
@@ -111,17 +366,27 @@ struct unbound_message_t {
 struct encoder_t {
     COCAINE_DECLARE_NONCOPYABLE(encoder_t)
 
-    encoder_t() = default;
+    encoder_t():
+        spare_size(0)
+    { }
+
    ~encoder_t() = default;
 
     typedef aux::unbound_message_t message_type;
     typedef aux::encoded_message_t encoded_message_type;
 
+    // Maximum number of spare packing buffers kept for reuse, and the maximum size of such buffers.
+    static const size_t kSpareBuffers = 16;
+    static const size_t kSpareBufferSize = 65536;
+
     template<class Event, class... Args>
     static inline
     aux::encoded_message_t
     tether(encoder_t& encoder, uint64_t channel_id, Args&... args) {
-        aux::encoded_message_t message;
+        aux::encoded_message_t message(encoder.acquire());
+
+        // Arguments are owned by the unbound message, so large ones can be referenced in place.
+        aux::pin_arguments(message.buffer, args...);
 
         msgpack::packer<aux::encoded_buffers_t> packer(message.buffer);
 
@@ -153,25 +418,86 @@ struct encoder_t {
     }
 
     aux::encoded_message_t
-    encode(const message_type& message) {
-        return message.bind(*this);
+    encode(message_type& message) {
+        return message.encode(*this);
+    }
+
+    // Returns the packing buffer of a message which is no longer needed for reuse.
+    void
+    recycle(aux::encoded_message_t&& message) {
+        if(spare.size() == kSpareBuffers || message.buffer.vector.size() > kSpareBufferSize) {
+            return;
+        }
+
+        if(spare.empty()) {
+            spare.reserve(kSpareBuffers);
+        }
+
+        spare_size += message.buffer.vector.size();
+        spare.emplace_back(std::move(message.buffer));
+    }
+
+    // Total size of the spare packing buffers in bytes.
+    auto
+    reserved() const -> size_t {
+        return spare_size;
+    }
+
+private:
+    auto
+    acquire() -> aux::encoded_buffers_t {
+        if(spare.empty()) {
+            return aux::encoded_buffers_t();
+        }
+
+        aux::encoded_buffers_t buffer(std::move(spare.back()));
+
+        spare.pop_back();
+        spare_size -= buffer.vector.size();
+        buffer.reset();
+
+        return buffer;
     }
 
 private:
     // HPACK HTTP/2.0 tables.
     hpack::header_table_t hpack_context;
+
+    std::vector<aux::encoded_buffers_t> spare;
+    size_t spare_size;
 };
 
+namespace aux {
+
+template<class Event, class IndexSequence, class... Args>
+struct tethered;
+
+// Message encoding function with its arguments bound, a lightweight alternative to std::bind().
+
+template<class Event, size_t... Indices, class... Args>
+struct tethered<Event, index_sequence<Indices...>, Args...> {
+    uint64_t channel_id;
+    std::tuple<Args...> args;
+
+    encoded_message_t
+    operator()(encoder_t& encoder) {
+        return encoder_t::tether<Event, Args...>(encoder, channel_id, std::get<Indices>(args)...);
+    }
+};
+
+} // namespace aux
+
 template<class Event>
 struct encoded:
     public aux::unbound_message_t
 {
     template<class... Args>
     encoded(uint64_t channel_id, Args&&... args): unbound_message_t(
-        std::bind(&encoder_t::tether<Event, typename std::decay<Args>::type...>,
-            std::placeholders::_1,
-            channel_id,
-            std::forward<Args>(args)...))
+        aux::tethered<
+            Event,
+            typename make_index_sequence<sizeof...(Args)>::type,
+            typename std::decay<Args>::type...
+        >{channel_id, std::tuple<typename std::decay<Args>::type...>(std::forward<Args>(args)...)})
     { }
 };
 
@@ -0,0 +1,179 @@
+/*
+    Copyright (c) 2011-2014 Andrey Sibiryov <me@kobology.ru>
+    Copyright (c) 2011-2014 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef COCAINE_IO_MEMORY_BUDGET_HPP
+#define COCAINE_IO_MEMORY_BUDGET_HPP
+
+#include "cocaine/common.hpp"
+
+#include <atomic>
+
+namespace cocaine { namespace io {
+
+// Accounts the memory held by the I/O streams: read rings, pooled read buffers, outbound queues and
+// spare packing buffers. Every execution unit has its own budget, which propagates all the charges
+// to the process-wide one. Charges never fail, the execution units check exceeded() periodically
+// and shed their clients instead.
+
+class memory_budget_t {
+    COCAINE_DECLARE_NONCOPYABLE(memory_budget_t)
+
+public:
+    explicit
+    memory_budget_t(size_t limit = 0, const std::shared_ptr<memory_budget_t>& parent = nullptr):
+        m_limit(limit),
+        m_parent(parent),
+        m_usage(0),
+        m_peak(0)
+    { }
+
+    void
+    charge(size_t bytes) {
+        const size_t usage = m_usage.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+
+        size_t peak = m_peak.load(std::memory_order_relaxed);
+
+        while(usage > peak && !m_peak.compare_exchange_weak(peak, usage)) {
+            // Empty.
+        }
+
+        if(m_parent) {
+            m_parent->charge(bytes);
+        }
+    }
+
+    void
+    discharge(size_t bytes) {
+        m_usage.fetch_sub(bytes, std::memory_order_relaxed);
+
+        if(m_parent) {
+            m_parent->discharge(bytes);
+        }
+    }
+
+    // Observers
+
+    auto
+    usage() const -> size_t {
+        return m_usage.load(std::memory_order_relaxed);
+    }
+
+    auto
+    peak() const -> size_t {
+        return m_peak.load(std::memory_order_relaxed);
+    }
+
+    auto
+    limit() const -> size_t {
+        return m_limit;
+    }
+
+    // Whether this budget or any of its parents is over its limit. Zero means no limit.
+    bool
+    exceeded() const {
+        return (m_limit && usage() > m_limit) || (m_parent && m_parent->exceeded());
+    }
+
+    // Moves the usage over to another parent, e.g. when a session is moved to another execution
+    // unit. Must be called by the thread charging this budget.
+    void
+    reparent(const std::shared_ptr<memory_budget_t>& parent) {
+        const size_t bytes = usage();
+
+        if(m_parent) {
+            m_parent->discharge(bytes);
+        }
+
+        if((m_parent = parent) != nullptr) {
+            m_parent->charge(bytes);
+        }
+    }
+
+private:
+    const size_t m_limit;
+    std::shared_ptr<memory_budget_t> m_parent;
+
+    std::atomic<size_t> m_usage;
+    std::atomic<size_t> m_peak;
+};
+
+// Memory charged to a budget by a single owner, e.g. a stream, which follows the owner's usage. It's
+// discharged completely once the owner is destroyed.
+
+class memory_charge_t {
+    COCAINE_DECLARE_NONCOPYABLE(memory_charge_t)
+
+public:
+    memory_charge_t():
+        m_charged(0)
+    { }
+
+   ~memory_charge_t() {
+        update(0);
+    }
+
+    // Sets the charge to the owner's current usage. It's tracked even without a budget, so that it
+    // could be charged once the owner gets one.
+    void
+    update(size_t usage) {
+        if(usage == m_charged) {
+            return;
+        }
+
+        if(m_budget && usage > m_charged) {
+            m_budget->charge(usage - m_charged);
+        } else if(m_budget) {
+            m_budget->discharge(m_charged - usage);
+        }
+
+        m_charged = usage;
+    }
+
+    // Moves the charge over to another budget, e.g. when the owner is moved to another execution
+    // unit. Null budgets aren't charged at all.
+    void
+    rebind(const std::shared_ptr<memory_budget_t>& budget) {
+        if(m_budget) {
+            m_budget->discharge(m_charged);
+        }
+
+        if((m_budget = budget) != nullptr) {
+            m_budget->charge(m_charged);
+        }
+    }
+
+    auto
+    budget() const -> const std::shared_ptr<memory_budget_t>& {
+        return m_budget;
+    }
+
+    auto
+    charged() const -> size_t {
+        return m_charged;
+    }
+
+private:
+    std::shared_ptr<memory_budget_t> m_budget;
+    size_t m_charged;
+};
+
+}} // namespace cocaine::io
+
+#endif
@@ -0,0 +1,64 @@
+/*
+    Copyright (c) 2011-2014 Andrey Sibiryov <me@kobology.ru>
+    Copyright (c) 2011-2014 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef COCAINE_IO_MIRRORED_BUFFER_HPP
+#define COCAINE_IO_MIRRORED_BUFFER_HPP
+
+#include "cocaine/common.hpp"
+
+namespace cocaine { namespace io {
+
+// Memory region mapped twice back to back, so that any range of at most size() bytes starting in
+// the first half is contiguous, even if it wraps around the end of the buffer. This allows to use it
+// as a ring without ever moving the data to the beginning of the buffer.
+
+class mirrored_buffer_t {
+    COCAINE_DECLARE_NONCOPYABLE(mirrored_buffer_t)
+
+    char* m_data;
+    size_t m_size;
+
+public:
+    // Throws std::system_error if the platform doesn't support such mappings. The size is rounded
+    // up to the page size.
+    explicit
+    mirrored_buffer_t(size_t size);
+
+   ~mirrored_buffer_t();
+
+    auto
+    data() const -> char* {
+        return m_data;
+    }
+
+    auto
+    size() const -> size_t {
+        return m_size;
+    }
+
+    // Returns the backing memory to the system, keeping the mappings intact. The contents of the
+    // buffer are zeroed.
+    void
+    discard();
+};
+
+}} // namespace cocaine::io
+
+#endif
@@ -23,11 +23,17 @@
 
 #include "cocaine/errors.hpp"
 
+#include "cocaine/rpc/asio/buffer_pool.hpp"
+#include "cocaine/rpc/asio/mirrored_buffer.hpp"
+#include "cocaine/rpc/asio/shared_channel.hpp"
+#include "cocaine/rpc/asio/uring.hpp"
+
 #include <functional>
 
 #include <asio/io_service.hpp>
 #include <asio/basic_stream_socket.hpp>
 
+#include <algorithm>
 #include <cstring>
 
 namespace cocaine { namespace io {
@@ -38,47 +44,449 @@ class readable_stream:
 {
     COCAINE_DECLARE_NONCOPYABLE(readable_stream)
 
-    static const size_t kInitialBufferSize = 65536;
-
     typedef typename Protocol::socket socket_type;
 
     typedef Decoder decoder_type;
     typedef typename decoder_type::message_type message_type;
 
-    const std::shared_ptr<socket_type> m_socket;
+    std::shared_ptr<socket_type> m_socket;
 
     typedef std::function<void(const std::error_code&)> handler_type;
 
-    std::vector<char, uninitialized<char>> m_ring;
-    std::vector<char, uninitialized<char>>::size_type m_rd_offset, m_rx_offset;
+    // The ring is borrowed from the pool only while there are some bytes pending.
+    std::shared_ptr<buffer_pool_t> m_pool;
+
+    buffer_pool_t::buffer_type m_ring;
+    buffer_pool_t::buffer_type::size_type m_rd_offset, m_rx_offset;
+
+    // Optional mirrored ring, used instead of the pooled one to avoid compacting the pending data.
+    bool m_mirrored;
+    std::unique_ptr<mirrored_buffer_t> m_mirror;
+
+    // The ring held by the stream, charged to the pool's memory budget.
+    memory_charge_t m_charge;
 
     decoder_type m_decoder;
 
+    // Total number of bytes received, for the idle connection detection.
+    uint64_t m_received;
+
+    // Maximum frame size in bytes, zero means no limit. Checked as soon as the incomplete frame
+    // grows over it, so that the ring is never grown for it.
+    size_t m_limit;
+
+    // The rings of the socket's reactor, if it has any, used instead of the reactor's own waits.
+    uring_t* m_uring;
+
+    // The io_uring operation in flight, if any, so that it could be cancelled.
+    uring_t::token_type m_operation;
+
+    // Capacity of the shared memory rings to offer to the client, zero disables the offer. Once
+    // the client has asked for them, all the bytes are read from the channel instead of the socket.
+    size_t m_shared;
+    bool m_fresh;
+
+    std::shared_ptr<shared_channel_t> m_channel;
+    std::function<void(const std::shared_ptr<shared_channel_t>&)> m_negotiated;
+
 public:
     explicit
-    readable_stream(const std::shared_ptr<socket_type>& socket):
-        m_socket(socket)
+    readable_stream(const std::shared_ptr<socket_type>& socket,
+                    const std::shared_ptr<buffer_pool_t>& pool = nullptr)
+    :
+        m_socket(socket),
+        // Streams without a shared pool keep at most one idle buffer around.
+        m_pool(pool ? pool : std::make_shared<buffer_pool_t>(1)),
+        m_mirrored(false),
+        m_received(0),
+        m_limit(0),
+        m_uring(uring_t::find(socket->get_io_service())),
+        m_operation(0),
+        m_shared(0),
+        m_fresh(true)
     {
-        m_ring.resize(kInitialBufferSize);
         m_rd_offset = m_rx_offset = 0;
+        m_charge.rebind(m_pool->budget());
+    }
+
+   ~readable_stream() {
+        release();
     }
 
     void
     read(message_type& message, handler_type handle) {
         std::error_code ec;
 
+        if(read_buffered(message, ec)) {
+            return m_socket->get_io_service().post(std::bind(handle, ec));
+        }
+
+        const size_t bytes_pending = m_rd_offset - m_rx_offset;
+
+        // NOTE: The frame is rejected as soon as its headers declare it too large, so that it isn't
+        // buffered up to the limit first.
+        if(m_limit && std::max(bytes_pending, m_decoder.expected()) > m_limit) {
+            return m_socket->get_io_service().post(std::bind(handle,
+                std::error_code(error::frame_too_large)));
+        }
+
+        namespace ph = std::placeholders;
+
+        if(!bytes_pending) {
+            // Nothing is pending, so return the ring to the pool and wait for the socket to become
+            // readable before borrowing it again.
+            release();
+
+            auto callback = std::bind(&readable_stream::ready, this->shared_from_this(),
+                std::ref(message), handle, ph::_1);
+
+            if(m_channel) {
+                return m_channel->async_wait_readable(std::move(callback));
+            }
+
+            if(uring()) {
+                m_operation = m_uring->poll(m_socket->native_handle(), std::move(callback));
+                return;
+            }
+
+            return m_socket->async_read_some(asio::null_buffers(), std::move(callback));
+        }
+
+        if(m_mirror) {
+            prepare_mirror(bytes_pending);
+        } else {
+            prepare_ring(bytes_pending);
+        }
+
+        const auto buffer = asio::buffer(ring_data() + m_rd_offset,
+            ring_size() - (m_mirror ? bytes_pending : m_rd_offset));
+
+        if(m_channel) {
+            return m_channel->async_wait_readable(std::bind(&readable_stream::resume,
+                this->shared_from_this(), std::ref(message), handle, buffer, ph::_1));
+        }
+
+        auto callback = std::bind(&readable_stream::fill, this->shared_from_this(),
+            std::ref(message), handle, ph::_1, ph::_2);
+
+        if(uring()) {
+            m_operation = m_uring->recv(m_socket->native_handle(),
+                asio::buffer_cast<void*>(buffer), asio::buffer_size(buffer), std::move(callback));
+            return;
+        }
+
+        m_socket->async_read_some(buffer, std::move(callback));
+    }
+
+    // Decodes the next frame if it has been already received, without going back to the reactor.
+    // Returns false if there's not enough data buffered to decode a complete frame.
+
+    bool
+    read_buffered(message_type& message, std::error_code& ec) {
         const size_t
             bytes_pending = m_rd_offset - m_rx_offset,
-            bytes_decoded = m_decoder.decode(m_ring.data() + m_rx_offset, bytes_pending, message, ec);
+            bytes_decoded = m_decoder.decode(ring_data() + m_rx_offset, bytes_pending, message, ec);
+
+        if(ec == error::insufficient_bytes) {
+            ec.clear();
+            return false;
+        }
+
+        if(!ec && m_limit && bytes_decoded > m_limit) {
+            // The whole frame might have been received in one go.
+            ec = error::frame_too_large;
+        }
+
+        if(!ec) {
+            m_rx_offset += bytes_decoded;
+        }
+
+        return true;
+    }
+
+    auto
+    pool() const -> const std::shared_ptr<buffer_pool_t>& {
+        return m_pool;
+    }
+
+    // Switches the stream to the mirrored ring. Falls back to the pooled ring silently if the platform
+    // doesn't support mirrored mappings.
+    void
+    mirrored(bool enable) {
+        m_mirrored = enable;
+    }
+
+    auto
+    mirrored() const -> bool {
+        return m_mirrored;
+    }
+
+    void
+    limit(size_t bytes) {
+        m_limit = bytes;
+    }
+
+    auto
+    limit() const -> size_t {
+        return m_limit;
+    }
+
+    void
+    shared(size_t capacity) {
+        m_shared = capacity;
+    }
+
+    auto
+    shared() const -> size_t {
+        return m_shared;
+    }
+
+    // Sets a handler to be invoked once the client has switched to the shared memory rings, so that
+    // the writing side could follow.
+    void
+    negotiated(std::function<void(const std::shared_ptr<shared_channel_t>&)> handle) {
+        m_negotiated = std::move(handle);
+    }
+
+    // Client side. Reads from the channel obtained with shared_channel_t::request() from now on.
+    void
+    attach(const std::shared_ptr<shared_channel_t>& channel) {
+        BOOST_ASSERT(!pending());
+
+        m_channel = channel;
+        m_fresh = false;
+    }
+
+    auto
+    channel() const -> const std::shared_ptr<shared_channel_t>& {
+        return m_channel;
+    }
+
+    auto
+    pressure() const -> size_t {
+        return ring_size();
+    }
+
+    // Charges the ring to the budget from now on, instead of the pool's one.
+    void
+    budget(const std::shared_ptr<memory_budget_t>& budget) {
+        m_charge.rebind(budget);
+    }
+
+    auto
+    budget() const -> const std::shared_ptr<memory_budget_t>& {
+        return m_charge.budget();
+    }
+
+    auto
+    received() const -> uint64_t {
+        return m_received;
+    }
+
+    // Number of received bytes not decoded yet.
+    auto
+    pending() const -> size_t {
+        return m_rd_offset - m_rx_offset;
+    }
+
+    // Cancels the io_uring operation in flight, if any, since closing the socket doesn't. Must be
+    // called before the socket is closed.
+    void
+    cancel() {
+        if(m_uring && m_operation) {
+            m_uring->cancel(m_operation);
+        }
+
+        m_operation = 0;
+    }
+
+    // NOTE: Switches the stream to another socket and buffer pool, e.g. when the connection is moved
+    // to another reactor. The decoder state is kept intact, but there must be no read in progress
+    // and nothing pending, so that the ring can be returned to the old pool.
+
+    void
+    rebind(const std::shared_ptr<socket_type>& socket, const std::shared_ptr<buffer_pool_t>& pool) {
+        BOOST_ASSERT(!pending());
+
+        release();
+
+        m_socket = socket;
+        m_pool = pool ? pool : m_pool;
+        m_uring = uring_t::find(socket->get_io_service());
+
+        m_charge.rebind(m_pool->budget());
+
+        if(m_channel) {
+            m_channel->rebind(socket->get_io_service());
+        }
+    }
+
+private:
+    // Returns the rings to use, unless they have failed since, in which case the stream falls back
+    // to the reactor for good.
+    auto
+    uring() -> uring_t* {
+        if(m_uring && !m_uring->usable()) {
+            m_uring = nullptr;
+        }
+
+        return m_uring;
+    }
 
-        if(ec != error::insufficient_bytes) {
-            if(!ec) {
-                m_rx_offset += bytes_decoded;
+    void
+    ready(message_type& message, handler_type handle, const std::error_code& ec) {
+        m_operation = 0;
+
+        if(!m_socket->is_open()) {
+            // NOTE: Closing the socket doesn't cancel io_uring operations, so it's checked here to
+            // behave the same way as the reactor does.
+            return;
+        }
+
+        if(ec) {
+            if(ec == asio::error::operation_aborted) {
+                return;
+            }
+
+            if(ec == asio::error::try_again) {
+                // The rings have failed, so wait through the reactor instead.
+                return read(message, handle);
             }
 
             return m_socket->get_io_service().post(std::bind(handle, ec));
         }
 
+        acquire();
+
+        std::error_code read_ec;
+
+        const size_t bytes_read = read_some(asio::buffer(ring_data(), ring_size()), read_ec);
+
+        if(read_ec == asio::error::would_block || read_ec == asio::error::try_again) {
+            // Spurious wakeup, go back to waiting.
+            return read(message, handle);
+        }
+
+        fill(message, handle, read_ec, bytes_read);
+    }
+
+    void
+    resume(message_type& message, handler_type handle, const asio::mutable_buffer& buffer,
+           const std::error_code& ec)
+    {
+        if(!m_socket->is_open() || ec) {
+            return fill(message, handle, ec, 0);
+        }
+
+        std::error_code read_ec;
+
+        const size_t bytes_read = read_some(asio::mutable_buffers_1(buffer), read_ec);
+
+        if(read_ec == asio::error::would_block) {
+            return read(message, handle);
+        }
+
+        fill(message, handle, read_ec, bytes_read);
+    }
+
+    template<class MutableBufferSequence>
+    auto
+    read_some(const MutableBufferSequence& buffers, std::error_code& ec) -> size_t {
+        if(m_channel) {
+            return m_channel->read_some(buffers, ec);
+        }
+
+        return m_socket->read_some(buffers, ec);
+    }
+
+    // NOTE: The client asks for the shared memory rings with a single magic byte, which can't start
+    // a valid frame, as the very first byte of the connection. Returns false if the negotiation has
+    // failed and the handler has been scheduled with the error.
+    bool
+    negotiate(handler_type& handle) {
+        m_fresh = false;
+
+        if(!m_shared || static_cast<unsigned char>(ring_data()[m_rx_offset]) !=
+                        shared_channel_t::kMagic)
+        {
+            return true;
+        }
+
+        if(m_rd_offset - m_rx_offset != 1) {
+            // The client must wait for the rings before sending anything else.
+            m_socket->get_io_service().post(std::bind(handle,
+                std::error_code(error::frame_format_error)));
+            return false;
+        }
+
+        try {
+            m_channel = shared_channel_t::offer(m_socket->get_io_service(),
+                m_socket->native_handle(), m_shared);
+        } catch(const std::system_error& e) {
+            m_socket->get_io_service().post(std::bind(handle, e.code()));
+            return false;
+        }
+
+        if(m_negotiated) {
+            m_negotiated(m_channel);
+        }
+
+        // The magic byte is the only thing received over the socket, so the ring can go back.
+        release();
+
+        return true;
+    }
+
+    auto
+    ring_data() const -> char* {
+        return m_mirror ? m_mirror->data() : const_cast<char*>(m_ring.data());
+    }
+
+    auto
+    ring_size() const -> size_t {
+        return m_mirror ? m_mirror->size() : m_ring.size();
+    }
+
+    void
+    acquire() {
+        if(m_mirrored && !m_mirror) {
+            try {
+                m_mirror = std::make_unique<mirrored_buffer_t>(buffer_pool_t::kBufferSize);
+            } catch(const std::system_error&) {
+                m_mirrored = false;
+            }
+        }
+
+        if(!m_mirror) {
+            m_ring = m_pool->acquire();
+        }
+
+        m_charge.update(ring_size());
+    }
+
+    void
+    release() {
+        m_rd_offset = m_rx_offset = 0;
+
+        m_charge.update(0);
+
+        if(m_mirror) {
+            if(m_mirror->size() > buffer_pool_t::kBufferSize) {
+                // Drop the ring grown for some huge frame, a new one will be mapped on demand.
+                m_mirror.reset();
+            } else {
+                m_mirror->discard();
+            }
+        }
+
+        if(!m_ring.empty()) {
+            // NOTE: Moved-from vectors are guaranteed to be empty.
+            m_pool->release(std::move(m_ring));
+        }
+    }
+
+    void
+    prepare_ring(size_t bytes_pending) {
         if(m_rx_offset) {
             // Compactify the ring before the asynchronous read operation.
             std::memmove(m_ring.data(), m_ring.data() + m_rx_offset, bytes_pending);
@@ -91,33 +499,79 @@ public:
             // The total size of unprocessed data in larger than half the size of the ring, so grow
             // the ring in order to accomodate more data.
             m_ring.resize(m_ring.size() * 2);
+            m_charge.update(ring_size());
         }
+    }
 
-        namespace ph = std::placeholders;
+    void
+    prepare_mirror(size_t bytes_pending) {
+        const size_t size = m_mirror->size();
+
+        if(m_rx_offset >= size) {
+            // The pending data is visible through both halves of the mapping, so rewinding the offsets
+            // is enough, no data is moved.
+            m_rx_offset -= size;
+            m_rd_offset -= size;
+        }
 
-        m_socket->async_read_some(
-            asio::buffer(m_ring.data() + m_rd_offset, m_ring.size() - m_rd_offset),
-            std::bind(&readable_stream::fill, this->shared_from_this(), std::ref(message), handle, ph::_1, ph::_2)
-        );
-    }
+        if(bytes_pending * 2 < size) {
+            return;
+        }
 
-    auto
-    pressure() const -> size_t {
-        return m_ring.size();
+        // The ring is too small for the pending frame, so the data has to be copied once anyway.
+        std::unique_ptr<mirrored_buffer_t> grown;
+
+        try {
+            grown = std::make_unique<mirrored_buffer_t>(size * 2);
+        } catch(const std::system_error&) {
+            // Fall back to the plain ring for the rest of the stream's lifetime. It's borrowed from
+            // the pool like any other, so that release() returns it there.
+            m_ring = m_pool->acquire();
+            m_ring.resize(size * 2);
+            std::memcpy(m_ring.data(), m_mirror->data() + m_rx_offset, bytes_pending);
+
+            m_mirror.reset();
+            m_mirrored = false;
+        }
+
+        if(grown) {
+            std::memcpy(grown->data(), m_mirror->data() + m_rx_offset, bytes_pending);
+            m_mirror = std::move(grown);
+        }
+
+        m_rd_offset = bytes_pending;
+        m_rx_offset = 0;
+
+        m_charge.update(ring_size());
     }
 
-private:
     void
     fill(message_type& message, handler_type handle, const std::error_code& ec, size_t bytes_read) {
+        m_operation = 0;
+
+        if(!m_socket->is_open()) {
+            return;
+        }
+
         if(ec) {
             if(ec == asio::error::operation_aborted) {
                 return;
             }
 
+            if(ec == asio::error::try_again) {
+                // Nothing has been received, so receive the same data through the reactor.
+                return read(message, handle);
+            }
+
             return m_socket->get_io_service().post(std::bind(handle, ec));
         }
 
         m_rd_offset += bytes_read;
+        m_received += bytes_read;
+
+        if(m_fresh && bytes_read && !negotiate(handle)) {
+            return;
+        }
 
         read(std::ref(message), handle);
     }
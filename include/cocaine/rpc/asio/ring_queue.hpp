@@ -0,0 +1,199 @@
+/*
+    Copyright (c) 2011-2014 Andrey Sibiryov <me@kobology.ru>
+    Copyright (c) 2011-2014 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef COCAINE_IO_RING_QUEUE_HPP
+#define COCAINE_IO_RING_QUEUE_HPP
+
+#include "cocaine/common.hpp"
+
+#include <iterator>
+
+namespace cocaine { namespace io {
+
+// FIFO queue on top of a growing ring buffer. Unlike std::deque, it never frees its storage, so once
+// it has grown large enough, pushing and popping the elements doesn't allocate any memory. Popped
+// slots are reset to the default constructed state to release the resources held by the elements.
+
+template<class T>
+class ring_queue {
+    std::vector<T> m_slots;
+
+    size_t m_head;
+    size_t m_size;
+
+public:
+    static const size_t kInitialCapacity = 16;
+
+    template<class Queue, class Value>
+    class iterator_impl {
+        Queue* queue;
+        size_t index;
+
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef typename std::remove_const<Value>::type value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef Value* pointer;
+        typedef Value& reference;
+
+        iterator_impl(Queue* queue_, size_t index_):
+            queue(queue_),
+            index(index_)
+        { }
+
+        Value&
+        operator*() const {
+            return queue->at(index);
+        }
+
+        Value*
+        operator->() const {
+            return &queue->at(index);
+        }
+
+        iterator_impl&
+        operator++() {
+            ++index;
+            return *this;
+        }
+
+        iterator_impl
+        operator++(int) {
+            return iterator_impl(queue, index++);
+        }
+
+        iterator_impl&
+        operator--() {
+            --index;
+            return *this;
+        }
+
+        iterator_impl
+        operator--(int) {
+            return iterator_impl(queue, index--);
+        }
+
+        bool
+        operator==(const iterator_impl& other) const {
+            return index == other.index;
+        }
+
+        bool
+        operator!=(const iterator_impl& other) const {
+            return index != other.index;
+        }
+    };
+
+    typedef T value_type;
+
+    typedef iterator_impl<ring_queue, T> iterator;
+    typedef iterator_impl<const ring_queue, const T> const_iterator;
+
+    ring_queue():
+        m_slots(kInitialCapacity),
+        m_head(0),
+        m_size(0)
+    { }
+
+    void
+    push_back(const T& value) {
+        if(m_size == m_slots.size()) {
+            grow();
+        }
+
+        at(m_size++) = value;
+    }
+
+    void
+    push_back(T&& value) {
+        if(m_size == m_slots.size()) {
+            grow();
+        }
+
+        at(m_size++) = std::move(value);
+    }
+
+    void
+    pop_front() {
+        BOOST_ASSERT(m_size);
+
+        m_slots[m_head] = T();
+        m_head = (m_head + 1) & (m_slots.size() - 1);
+
+        --m_size;
+    }
+
+    T&
+    front() {
+        return m_slots[m_head];
+    }
+
+    T&
+    back() {
+        return at(m_size - 1);
+    }
+
+    void
+    clear() {
+        while(m_size) pop_front();
+    }
+
+    auto
+    size() const -> size_t {
+        return m_size;
+    }
+
+    auto
+    empty() const -> bool {
+        return m_size == 0;
+    }
+
+    iterator       begin()       { return iterator(this, 0); }
+    iterator       end()         { return iterator(this, m_size); }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end()   const { return const_iterator(this, m_size); }
+
+    T&
+    at(size_t index) {
+        return m_slots[(m_head + index) & (m_slots.size() - 1)];
+    }
+
+    const T&
+    at(size_t index) const {
+        return m_slots[(m_head + index) & (m_slots.size() - 1)];
+    }
+
+private:
+    void
+    grow() {
+        std::vector<T> slots(m_slots.size() * 2);
+
+        for(size_t i = 0; i < m_size; ++i) {
+            slots[i] = std::move(at(i));
+        }
+
+        m_slots.swap(slots);
+        m_head = 0;
+    }
+};
+
+}} // namespace cocaine::io
+
+#endif
@@ -0,0 +1,231 @@
+/*
+    Copyright (c) 2011-2014 Andrey Sibiryov <me@kobology.ru>
+    Copyright (c) 2011-2014 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef COCAINE_IO_SHARED_CHANNEL_HPP
+#define COCAINE_IO_SHARED_CHANNEL_HPP
+
+#include "cocaine/common.hpp"
+
+#include <atomic>
+#include <functional>
+
+#include <asio/buffer.hpp>
+#include <asio/io_service.hpp>
+#include <asio/posix/stream_descriptor.hpp>
+
+namespace cocaine { namespace io {
+
+// NOTE: A pair of single-producer single-consumer byte rings in memory shared by two co-located
+// processes, negotiated over a unix socket connection between them. In the steady state bytes are
+// exchanged without any syscalls at all, an eventfd(2) is written only to wake the peer up if it
+// went to sleep waiting for data or for space. The unix socket itself is only watched to detect
+// that the peer has gone away.
+//
+// Negotiation: the client sends a single kMagic byte over the socket as the very first byte of the
+// connection and nothing else. The server replies with the ring capacity as a 64-bit integer along
+// with the shared memory, the client's and the server's eventfd descriptors in SCM_RIGHTS, in this
+// order. The first ring carries the bytes from the client to the server, the second one back.
+//
+// NOTE: The peer might be any local process able to connect to the socket, and it can write
+// anything into the shared headers at any time. Each side keeps its own indices privately and only
+// checks the peer's ones against them, the channel breaks for good on the first inconsistency.
+
+class shared_channel_t:
+    public std::enable_shared_from_this<shared_channel_t>
+{
+    COCAINE_DECLARE_NONCOPYABLE(shared_channel_t)
+
+public:
+    typedef std::function<void(const std::error_code&)> handler_type;
+
+    // Never valid as the first byte of a msgpack frame.
+    static const unsigned char kMagic = 0xc1;
+
+    struct header_t {
+        // Total number of bytes consumed and produced.
+        alignas(64) std::atomic<uint64_t> head;
+        alignas(64) std::atomic<uint64_t> tail;
+
+        // Raised by the consumer before it sleeps waiting for data and by the producer before it
+        // sleeps waiting for space, so that the other side knows it has to wake it up.
+        alignas(64) std::atomic<uint32_t> sleeping;
+        std::atomic<uint32_t> starving;
+    };
+
+private:
+    struct ring_t {
+        header_t* header;
+        char* data;
+    };
+
+    void*  m_memory;
+    size_t m_size;
+    size_t m_capacity;
+
+    ring_t m_rx;
+    ring_t m_tx;
+
+    // Private copies of the indices owned by this side, the inbound head and the outbound tail. The
+    // shared ones are only written, never trusted.
+    uint64_t m_consumed;
+    uint64_t m_produced;
+
+    // Own eventfd, written by the peer, and the peer's one.
+    std::unique_ptr<asio::posix::stream_descriptor> m_wakeup;
+    int m_notify;
+
+    // Duplicate of the unix socket descriptor, readable only once the peer has gone away.
+    std::unique_ptr<asio::posix::stream_descriptor> m_control;
+
+    handler_type m_readable;
+    handler_type m_writable;
+
+    bool m_armed;
+    bool m_watched;
+    bool m_closed;
+
+    // Set once the peer has corrupted the ring headers. All the operations fail with EPROTO then.
+    bool m_broken;
+
+public:
+    // Use offer() and request() instead.
+    shared_channel_t(asio::io_service& asio, int socket, void* memory, size_t capacity, bool server,
+                     int wakeup, int notify);
+
+   ~shared_channel_t();
+
+    // Server side. Creates the rings and hands them over to the client through the socket, after
+    // the kMagic byte has been received from it.
+    static
+    auto
+    offer(asio::io_service& asio, int socket, size_t capacity) -> std::shared_ptr<shared_channel_t>;
+
+    // Client side. Requests the rings from the server through the socket, blocking until they are
+    // received. No other data must be sent over the socket before.
+    static
+    auto
+    request(asio::io_service& asio, int socket) -> std::shared_ptr<shared_channel_t>;
+
+    auto
+    capacity() const -> size_t {
+        return m_capacity;
+    }
+
+    // Ring headers, shared with the peer. Only meant for tests, see the note above.
+    auto
+    inbound() const -> header_t& {
+        return *m_rx.header;
+    }
+
+    auto
+    outbound() const -> header_t& {
+        return *m_tx.header;
+    }
+
+    // Non-blocking I/O with the same semantics as the socket operations. Fails with would_block if
+    // there's no data or no space, and with eof or broken_pipe once the peer has gone away. Fails
+    // with EPROTO if the peer has corrupted the ring headers.
+
+    template<class MutableBufferSequence>
+    size_t
+    read_some(const MutableBufferSequence& buffers, std::error_code& ec) {
+        size_t bytes_read = 0;
+
+        for(auto it = buffers.begin(); it != buffers.end(); ++it) {
+            const size_t size = asio::buffer_size(*it);
+            const size_t done = read(asio::buffer_cast<char*>(*it), size);
+
+            bytes_read += done;
+
+            if(done < size) {
+                break;
+            }
+        }
+
+        return complete(bytes_read, true, ec);
+    }
+
+    template<class ConstBufferSequence>
+    size_t
+    write_some(const ConstBufferSequence& buffers, std::error_code& ec) {
+        size_t bytes_written = 0;
+
+        if(!m_closed) {
+            for(auto it = buffers.begin(); it != buffers.end(); ++it) {
+                const size_t size = asio::buffer_size(*it);
+                const size_t done = write(asio::buffer_cast<const char*>(*it), size);
+
+                bytes_written += done;
+
+                if(done < size) {
+                    break;
+                }
+            }
+        }
+
+        return complete(bytes_written, false, ec);
+    }
+
+    // One-shot waits for some data or some space to become available. The handlers are invoked
+    // through the reactor even if the condition holds right away.
+
+    void
+    async_wait_readable(handler_type handle);
+
+    void
+    async_wait_writable(handler_type handle);
+
+    // Moves the channel to another reactor. There must be no waits in progress.
+    void
+    rebind(asio::io_service& target);
+
+private:
+    auto
+    read(char* data, size_t size) -> size_t;
+
+    auto
+    write(const char* data, size_t size) -> size_t;
+
+    // Wakes the peer up if it has asked to, publishing the consumed or produced bytes first.
+    auto
+    complete(size_t bytes, bool consumed, std::error_code& ec) -> size_t;
+
+    bool
+    readable() const;
+
+    bool
+    writable() const;
+
+    void
+    arm();
+
+    void
+    wakeup(const std::error_code& ec);
+
+    void
+    watch();
+
+    void
+    hangup(const std::error_code& ec);
+};
+
+}} // namespace cocaine::io
+
+#endif
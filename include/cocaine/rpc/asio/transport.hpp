@@ -27,6 +27,8 @@
 #include "cocaine/rpc/asio/writable_stream.hpp"
 #include "cocaine/rpc/asio/encoder.hpp"
 
+#include <unistd.h>
+
 namespace cocaine { namespace io {
 
 template<class Protocol, class Encoder, class Decoder>
@@ -37,25 +39,92 @@ struct transport {
     typedef typename protocol_type::socket socket_type;
 
     explicit
-    transport(std::unique_ptr<socket_type> socket_):
+    transport(std::unique_ptr<socket_type> socket_,
+              const std::shared_ptr<buffer_pool_t>& pool = nullptr)
+    :
         socket(std::move(socket_)),
-        reader(new readable_stream<protocol_type, decoder_type>(socket)),
+        reader(new readable_stream<protocol_type, decoder_type>(socket, pool)),
         writer(new writable_stream<protocol_type, encoder_type>(socket))
     {
         socket->non_blocking(true);
+
+        writer->budget(reader->pool()->budget());
+
+        follow();
     }
 
     // Conversion constructor between transports with compatible underlying protocols.
     template<class OtherProtocol>
     transport(transport<OtherProtocol, encoder_type, decoder_type>&& other):
         socket(new socket_type(std::move(*other.socket))),
-        reader(new readable_stream<protocol_type, decoder_type>(socket)),
+        reader(new readable_stream<protocol_type, decoder_type>(socket, other.reader->pool())),
         writer(new writable_stream<protocol_type, encoder_type>(socket))
     {
         // The socket is already in non-blocking mode.
+        reader->mirrored(other.reader->mirrored());
+        reader->shared(other.reader->shared());
+        reader->limit(other.reader->limit());
+        writer->coalesce(other.writer->coalesce());
+        writer->limit(other.writer->limit());
+        writer->interleave(other.writer->interleave());
+        writer->stats(other.writer->stats());
+        writer->budget(reader->pool()->budget());
+
+        if(other.reader->channel()) {
+            reader->attach(other.reader->channel());
+            writer->attach(other.reader->channel());
+        }
+
+        follow();
+    }
+
+    // Charges both streams to the budget from now on, e.g. the session's one.
+    void
+    budget(const std::shared_ptr<memory_budget_t>& budget) {
+        reader->budget(budget);
+        writer->budget(budget);
+    }
+
+    // NOTE: Moves the connection to another reactor, keeping the buffered data and the codec state.
+    // There must be no operations in progress on the socket, see readable_stream::rebind() and
+    // writable_stream::rebind() for the exact requirements.
+
+    void
+    migrate(asio::io_service& target, const std::shared_ptr<buffer_pool_t>& pool = nullptr) {
+        int fd;
+
+        if((fd = ::dup(socket->native_handle())) == -1) {
+            throw std::system_error(errno, std::system_category(), "unable to clone socket");
+        }
+
+        std::shared_ptr<socket_type> clone;
+
+        try {
+            clone = std::make_shared<socket_type>(target, socket->local_endpoint().protocol(), fd);
+        } catch(...) {
+            ::close(fd);
+            throw;
+        }
+
+        clone->non_blocking(true);
+
+        std::error_code ec;
+
+        // The original descriptor is closed without a shutdown, so the connection stays intact.
+        socket->close(ec);
+        socket = clone;
+
+        reader->rebind(socket, pool);
+        writer->rebind(socket);
+        writer->budget(reader->pool()->budget());
     }
 
    ~transport() {
+        // NOTE: The io_uring operations in flight keep the streams alive and aren't cancelled by
+        // closing the socket, so without it an idle connection would wait for the peer forever.
+        reader->cancel();
+        writer->cancel();
+
         try {
             socket->shutdown(socket_type::shutdown_both);
             socket->close();
@@ -64,12 +133,25 @@ struct transport {
         }
     }
 
-    // The underlying shared socket object.
-    const std::shared_ptr<socket_type> socket;
+    // The underlying shared socket object. Replaced only when the connection is migrated.
+    std::shared_ptr<socket_type> socket;
 
     // Unidirectional transport streams.
     const std::shared_ptr<readable_stream<protocol_type, decoder_type>> reader;
     const std::shared_ptr<writable_stream<protocol_type, encoder_type>> writer;
+
+private:
+    // Switches the writing side to the shared memory rings once the client has asked for them.
+    void
+    follow() {
+        std::weak_ptr<writable_stream<protocol_type, encoder_type>> weak(writer);
+
+        reader->negotiated([weak](const std::shared_ptr<shared_channel_t>& channel) {
+            if(auto ptr = weak.lock()) {
+                ptr->attach(channel);
+            }
+        });
+    }
 };
 
 }} // namespace cocaine::io
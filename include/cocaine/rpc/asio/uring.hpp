@@ -0,0 +1,240 @@
+/*
+    Copyright (c) 2011-2014 Andrey Sibiryov <me@kobology.ru>
+    Copyright (c) 2011-2014 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef COCAINE_IO_URING_HPP
+#define COCAINE_IO_URING_HPP
+
+#include "cocaine/common.hpp"
+
+#include <deque>
+#include <functional>
+
+#include <asio/buffer.hpp>
+#include <asio/io_service.hpp>
+#include <asio/posix/stream_descriptor.hpp>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+namespace cocaine { namespace io {
+
+// NOTE: The io_uring(7) rings of a reactor, plugged into it as an asio service, so that the streams
+// of every connection on that reactor can find them via uring_t::find(). The operations submitted
+// during a reactor turn are batched into a single io_uring_enter(2) call, and their completions are
+// reaped once the ring descriptor becomes readable. All the methods must be called on the reactor
+// thread.
+
+class uring_t:
+    public asio::io_service::service
+{
+    COCAINE_DECLARE_NONCOPYABLE(uring_t)
+
+public:
+    typedef std::function<void(const std::error_code&, size_t)> handler_type;
+
+    // Identifies an operation in flight for cancellation, never zero.
+    typedef uint64_t token_type;
+
+    static asio::io_service::id id;
+
+    // Maximum number of buffers in a single send, the same as asio's own limit.
+    static const size_t kMaxBuffers = 64;
+
+    struct stats_t {
+        // Number of operations and io_uring_enter(2) calls they were submitted with.
+        size_t operations;
+        size_t submissions;
+    };
+
+private:
+    struct ring_t;
+
+    struct slot_t {
+        handler_type handle;
+
+        // Bumped every time the slot is reused, so that a stale token never cancels a newer
+        // operation in the same slot.
+        uint32_t generation;
+
+        // Whether a zero-byte completion means that the peer has closed the connection.
+        bool stream;
+
+        // Scatter-gather sequence and header of a send, kept until the send completes.
+        std::vector<iovec> buffers;
+        msghdr message;
+    };
+
+    std::unique_ptr<ring_t> m_ring;
+
+    // Watches the ring descriptor for completions. It's only armed while there are operations in
+    // flight, so that the reactor could run out of work.
+    std::unique_ptr<asio::posix::stream_descriptor> m_descriptor;
+    bool m_armed;
+
+    // Operation slots, indexed by the low half of the completion user data. Slots are reused, so
+    // that submitting operations doesn't allocate any memory in a steady state.
+    // NOTE: A deque, because the submission entries point to the message headers in the slots,
+    // and they must stay put until the entries are submitted, even if more slots are added.
+    std::deque<slot_t> m_slots;
+    std::vector<size_t> m_free;
+
+    // A submission entry which hasn't fit into the submission queue yet.
+    struct entry_t {
+        unsigned opcode;
+        int fd;
+        const void* data;
+        size_t size;
+        unsigned flags;
+        size_t index;
+    };
+
+    // Operations waiting for room in the full submission queue, queued in order once there is.
+    std::deque<entry_t> m_backlog;
+
+    // Number of operations queued but not submitted yet, and not completed yet.
+    size_t m_queued;
+    size_t m_inflight;
+
+    // Whether a submission is posted to the reactor and hasn't run yet.
+    bool m_scheduled;
+
+    // Set once the rings have failed, all the operations fail with it afterwards. The streams fall
+    // back to the reactor once the rings aren't usable anymore, see usable().
+    std::error_code m_error;
+
+    stats_t m_stats;
+
+public:
+    // Throws std::system_error if the kernel doesn't support io_uring or some of the operations.
+    explicit
+    uring_t(asio::io_service& asio);
+
+   ~uring_t();
+
+    // Returns the rings of the reactor, or nullptr if it doesn't have any or they have failed.
+    static
+    auto
+    find(asio::io_service& asio) -> uring_t*;
+
+    // Waits for the descriptor to become readable.
+    auto
+    poll(int fd, handler_type handle) -> token_type;
+
+    // Receives at most size bytes. Completes with asio::error::eof if the peer has closed the
+    // connection.
+    auto
+    recv(int fd, void* data, size_t size, handler_type handle) -> token_type;
+
+    // Sends at most kMaxBuffers buffers of the sequence. The data must stay intact until the
+    // operation completes, but the sequence itself may be modified right away.
+    template<class ConstBufferSequence>
+    auto
+    send(int fd, const ConstBufferSequence& sequence, handler_type handle) -> token_type {
+        const size_t index = allocate(std::move(handle), false);
+
+        slot_t& slot = m_slots[index];
+
+        slot.buffers.clear();
+
+        for(auto it = sequence.begin(); it != sequence.end(); ++it) {
+            if(slot.buffers.size() == kMaxBuffers) {
+                break;
+            }
+
+            slot.buffers.push_back(iovec{
+                const_cast<void*>(asio::buffer_cast<const void*>(*it)),
+                asio::buffer_size(*it)
+            });
+        }
+
+        return sendmsg(fd, index);
+    }
+
+    // NOTE: Closing a descriptor doesn't cancel the io_uring operations on it, so the owner of
+    // the descriptor must cancel them explicitly. The operation completes with operation_aborted,
+    // unless it has already completed, in which case nothing happens.
+
+    void
+    cancel(token_type token);
+
+    // Whether the rings are still working. Once they have failed, the operations in flight complete
+    // with asio::error::try_again, so that they could be retried through the reactor.
+    auto
+    usable() const -> bool {
+        return m_ring != nullptr;
+    }
+
+    auto
+    stats() const -> const stats_t& {
+        return m_stats;
+    }
+
+private:
+    virtual
+    void
+    shutdown_service();
+
+    auto
+    allocate(handler_type handle, bool stream) -> size_t;
+
+    auto
+    token(size_t index) const -> token_type;
+
+    auto
+    sendmsg(int fd, size_t index) -> token_type;
+
+    // Queues a submission entry. If the queue is full, the entry waits in the backlog until the
+    // next submission makes some room.
+    void
+    enqueue(unsigned opcode, int fd, const void* data, size_t size, unsigned flags, size_t index);
+
+    // Moves as many backlogged entries into the submission queue as there's room for.
+    void
+    refill();
+
+    void
+    schedule();
+
+    void
+    submit();
+
+    void
+    arm();
+
+    void
+    reap(const std::error_code& ec);
+
+    // Fails the operation through the reactor, as if it has been completed by the kernel.
+    void
+    abort(size_t index, const std::error_code& ec);
+
+    // Closes the broken rings and aborts all the operations in flight, so that they're retried
+    // through the reactor.
+    void
+    fail(const std::error_code& ec);
+
+    // Invokes the handlers of all the completed operations.
+    void
+    drain();
+};
+
+}} // namespace cocaine::io
+
+#endif
@@ -22,17 +22,37 @@
 #define COCAINE_IO_BUFFERED_WRITABLE_STREAM_HPP
 
 #include "cocaine/errors.hpp"
+
+#include "cocaine/idl/control.hpp"
+
+#include "cocaine/rpc/asio/memory_budget.hpp"
+#include "cocaine/rpc/asio/ring_queue.hpp"
+#include "cocaine/rpc/asio/shared_channel.hpp"
+#include "cocaine/rpc/asio/uring.hpp"
 #include "cocaine/trace/trace.hpp"
 
+#include <array>
+#include <atomic>
 #include <functional>
+#include <list>
 
 #include <asio/io_service.hpp>
 #include <asio/basic_stream_socket.hpp>
 
-#include <deque>
+#include <iterator>
 
 namespace cocaine { namespace io {
 
+// Outbound counters, shared by all the streams of an execution unit.
+struct outbound_stats_t {
+    outbound_stats_t(): messages(0), writes(0) { }
+
+    // Messages queued and write calls issued to send them, the latter including the asynchronous
+    // ones. The ratio shows how well the writes are coalesced.
+    std::atomic<uint64_t> messages;
+    std::atomic<uint64_t> writes;
+};
+
 template<class Protocol, class Encoder>
 class writable_stream:
     public std::enable_shared_from_this<writable_stream<Protocol, Encoder>>
@@ -44,115 +64,620 @@ class writable_stream:
     typedef Encoder encoder_type;
     typedef typename encoder_type::message_type message_type;
 
-    const std::shared_ptr<socket_type> m_socket;
-
+public:
     typedef std::function<void(const std::error_code&)> handler_type;
 
-    std::deque<asio::const_buffer> m_messages;
-    std::deque<typename Encoder::encoded_message_type> m_encoded_messages;
-    std::deque<handler_type> m_handlers;
+private:
+    std::shared_ptr<socket_type> m_socket;
+
+    // Size of the msgpack prefix of the fragment frames, up to the fragment body. The frames end
+    // with an empty header list right after the body.
+    static const size_t kFragmentHeaderSize = 19;
+
+    // Message larger than the interleaving fragment size, sent in fragments one at a time. The next
+    // fragment is queued only once the previous one has been written, so that all the messages
+    // queued in the meantime are sent before it.
+    struct stream_t {
+        message_type message;
+        typename encoder_type::encoded_message_type encoded;
+
+        handler_type handle;
+
+        // The whole message's scatter-gather sequence and the position of the next fragment in it.
+        std::vector<asio::const_buffer> buffers;
+        size_t index;
+        size_t offset;
+        size_t remaining;
+
+        // Fragment size, fixed once the stream is created.
+        size_t chunk;
+
+        uint64_t id;
+
+        std::array<char, kFragmentHeaderSize> header;
+    };
+
+    struct pending_t {
+        message_type message;
+        typename encoder_type::encoded_message_type encoded;
 
-    enum class states { idle, flushing } m_state;
+        // Number of buffers of this message in the scatter-gather sequence not yet written.
+        size_t segments;
+
+        handler_type handle;
+
+        // Set if this is a fragment of the stream, the message itself is owned by the stream then.
+        stream_t* stream;
+    };
+
+    // Scatter-gather sequence of all the pending messages. Every message might span several buffers
+    // if some of its arguments are referenced by the encoder instead of being copied. Both queues
+    // keep their storage, so that writing messages doesn't allocate any memory in a steady state.
+    ring_queue<asio::const_buffer> m_messages;
+    ring_queue<pending_t> m_queue;
+
+    // Messages being sent in fragments and the last used stream id.
+    std::list<stream_t> m_streams;
+    uint64_t m_stream_id;
+
+    // Invoked once if the stream fails, along with the handlers of all the pending messages.
+    handler_type m_failed;
+
+    enum class states { idle, coalescing, flushing } m_state;
+
+    // Whether a coalesced transmission is posted to the reactor and hasn't run yet.
+    bool m_scheduled;
+
+    // Maximum number of bytes gathered from the messages written during one reactor turn before
+    // they are sent with a single write. Zero disables write coalescing.
+    size_t m_coalesce;
+
+    // Total size of the pending messages in bytes.
+    size_t m_pending;
+
+    // Total number of bytes written, for the idle connection detection.
+    uint64_t m_transmitted;
+
+    // Total number of write calls issued, optionally accounted in the shared stats as well.
+    uint64_t m_writes;
+    std::shared_ptr<outbound_stats_t> m_stats;
+
+    // Outbound queue size limit, zero means no limit. Once the queue goes over it, the drain
+    // handler is invoked as soon as the pending data size falls to the half of the limit.
+    size_t m_limit;
+    std::function<void()> m_drained;
+
+    // Fragment size for the large messages, zero disables interleaving.
+    size_t m_interleave;
 
     encoder_type encoder;
 
+    // The pending messages and the encoder's spare buffers, charged to the memory budget.
+    memory_charge_t m_charge;
+
+    // The rings of the socket's reactor, if it has any, used instead of the reactor's own writes.
+    uring_t* m_uring;
+
+    // The io_uring send in flight, if any, so that it could be cancelled.
+    uring_t::token_type m_operation;
+
+    // The shared memory rings negotiated by the reading side, used instead of the socket.
+    std::shared_ptr<shared_channel_t> m_channel;
+
 public:
     explicit
     writable_stream(const std::shared_ptr<socket_type>& socket):
         m_socket(socket),
-        m_state(states::idle)
+        m_stream_id(0),
+        m_state(states::idle),
+        m_scheduled(false),
+        m_coalesce(0),
+        m_pending(0),
+        m_transmitted(0),
+        m_writes(0),
+        m_limit(0),
+        m_interleave(0),
+        m_uring(uring_t::find(socket->get_io_service())),
+        m_operation(0)
     { }
 
+    // NOTE: The message is kept by the stream until it's written, because its encoded form might
+    // reference the message arguments. The completion handler is optional, the messages without
+    // one are completed without posting anything to the reactor.
+
     void
-    write(const message_type& message, handler_type handle) {
-        size_t bytes_written = 0;
+    write(message_type&& message, handler_type handle = handler_type()) {
+        BOOST_ASSERT(m_state != states::idle || m_messages.empty());
+
+        m_queue.push_back(pending_t{std::move(message), {}, 0, std::move(handle), nullptr});
 
-        auto encoded = encoder.encode(message);
+        if(m_stats) {
+            m_stats->messages.fetch_add(1, std::memory_order_relaxed);
+        }
 
-        if(m_state == states::idle) {
-            std::error_code ec;
+        pending_t& pending = m_queue.back();
 
-            // Try to write some data right away, as we don't have anything pending.
-            bytes_written = m_socket->write_some(asio::buffer(encoded.data(), encoded.size()), ec);
+        pending.encoded = encoder.encode(pending.message);
 
-            if(!ec && bytes_written == encoded.size()) {
-                return m_socket->get_io_service().post(trace_t::bind(handle, ec));
-            }
+        if(m_interleave && pending.encoded.size() > m_interleave) {
+            split(pending);
+        } else {
+            pending.segments = pending.encoded.count();
+            pending.encoded.buffers(std::back_inserter(m_messages));
+
+            m_pending += pending.encoded.size();
         }
 
-        m_messages.emplace_back(encoded.data() + bytes_written, encoded.size() - bytes_written);
-        m_handlers.emplace_back(handle);
-        m_encoded_messages.emplace_back(std::move(encoded));
+        m_charge.update(m_pending + encoder.reserved());
 
         if(m_state == states::flushing) {
             return;
-        } else {
-            m_state = states::flushing;
         }
 
-        namespace ph = std::placeholders;
+        if(m_coalesce && m_pending < m_coalesce) {
+            if(m_state == states::idle) {
+                m_state = states::coalescing;
+
+                if(!m_scheduled) {
+                    m_scheduled = true;
+
+                    // Let all the messages written during this reactor turn join this one.
+                    m_socket->get_io_service().post(std::bind(&writable_stream::coalesced,
+                        this->shared_from_this()));
+                }
+            }
+
+            return;
+        }
 
-        m_socket->async_write_some(
-            m_messages,
-            std::bind(&writable_stream::flush, this->shared_from_this(), ph::_1, ph::_2)
-        );
+        transmit();
+    }
+
+    void
+    coalesce(size_t budget) {
+        m_coalesce = budget;
+    }
+
+    auto
+    coalesce() const -> size_t {
+        return m_coalesce;
+    }
+
+    void
+    limit(size_t bytes) {
+        m_limit = bytes;
+    }
+
+    auto
+    limit() const -> size_t {
+        return m_limit;
+    }
+
+    // NOTE: Only the messages written afterwards are affected. The peer must be able to reassemble
+    // the fragments, see control::fragment. Reassembled messages are decoded out of their encoding
+    // order, which is fine since the encoder never references the dynamic HPACK table entries.
+
+    void
+    interleave(size_t fragment) {
+        m_interleave = fragment;
+    }
+
+    auto
+    interleave() const -> size_t {
+        return m_interleave;
+    }
+
+    // Charges the pending messages to the budget from now on, e.g. the execution unit's one.
+    void
+    budget(const std::shared_ptr<memory_budget_t>& budget) {
+        m_charge.rebind(budget);
+    }
+
+    auto
+    budget() const -> const std::shared_ptr<memory_budget_t>& {
+        return m_charge.budget();
+    }
+
+    auto
+    overloaded() const -> bool {
+        return m_limit && m_pending > m_limit;
+    }
+
+    // Sets a handler to be invoked if the stream fails.
+    void
+    failed(handler_type handle) {
+        m_failed = std::move(handle);
+    }
+
+    // Sets a one-shot handler to be invoked once the outbound queue is drained to the half of the
+    // limit. It is dropped without being invoked if the stream fails.
+    void
+    drained(std::function<void()> handle) {
+        m_drained = std::move(handle);
     }
 
     auto
     pressure() const -> size_t {
-        return asio::buffer_size(m_messages);
+        return m_pending;
+    }
+
+    auto
+    transmitted() const -> uint64_t {
+        return m_transmitted;
+    }
+
+    auto
+    writes() const -> uint64_t {
+        return m_writes;
+    }
+
+    // Accounts the messages and the writes in the stats from now on, e.g. the execution unit's.
+    void
+    stats(const std::shared_ptr<outbound_stats_t>& stats) {
+        m_stats = stats;
+    }
+
+    auto
+    stats() const -> const std::shared_ptr<outbound_stats_t>& {
+        return m_stats;
+    }
+
+    // Whether the stream has nothing to write and no operations outstanding in the reactor.
+    auto
+    idle() const -> bool {
+        return m_state == states::idle && !m_scheduled && m_messages.empty();
+    }
+
+    // Writes to the channel from now on. The stream must be idle.
+    void
+    attach(const std::shared_ptr<shared_channel_t>& channel) {
+        BOOST_ASSERT(idle());
+
+        m_channel = channel;
+    }
+
+    auto
+    channel() const -> const std::shared_ptr<shared_channel_t>& {
+        return m_channel;
+    }
+
+    // Cancels the io_uring send in flight, if any, since closing the socket doesn't. Must be called
+    // before the socket is closed.
+    void
+    cancel() {
+        if(m_uring && m_operation) {
+            m_uring->cancel(m_operation);
+        }
+
+        m_operation = 0;
+    }
+
+    // NOTE: Switches the stream to another socket, e.g. when the connection is moved to another
+    // reactor. The encoder state is kept intact, but the stream must be idle.
+
+    void
+    rebind(const std::shared_ptr<socket_type>& socket) {
+        BOOST_ASSERT(idle());
+
+        m_socket = socket;
+        m_uring = uring_t::find(socket->get_io_service());
     }
 
 private:
+    // Returns the rings to use, unless they have failed since, in which case the stream falls back
+    // to the reactor for good.
+    auto
+    uring() -> uring_t* {
+        if(m_uring && !m_uring->usable()) {
+            m_uring = nullptr;
+        }
+
+        return m_uring;
+    }
+
+    // Moves the message over to a new stream and turns its queue entry into the first fragment.
+    void
+    split(pending_t& pending) {
+        m_streams.emplace_back();
+
+        stream_t& stream = m_streams.back();
+
+        stream.message = std::move(pending.message);
+        stream.encoded = std::move(pending.encoded);
+        stream.handle  = std::move(pending.handle);
+
+        stream.encoded.buffers(std::back_inserter(stream.buffers));
+        stream.index = 0;
+        stream.offset = 0;
+        stream.remaining = stream.encoded.size();
+        stream.chunk = m_interleave;
+        stream.id = ++m_stream_id;
+
+        m_pending += stream.remaining;
+
+        pending.segments = fragment(stream);
+        pending.stream = &stream;
+    }
+
+    // Appends the next fragment of the stream to the scatter-gather sequence, returning the number
+    // of buffers it spans.
+    auto
+    fragment(stream_t& stream) -> size_t {
+        static_assert(event_traits<control::fragment>::id < 0x80, "fragment id must be a fixint");
+
+        static const char kTrailer = '\x90';
+
+        const size_t size = std::min(stream.remaining, stream.chunk);
+
+        // [0, fragment, [id, last, body], []]
+        char* header = stream.header.data();
+
+        *header++ = '\x94';
+        *header++ = '\x00';
+        *header++ = static_cast<char>(event_traits<control::fragment>::id);
+        *header++ = '\x93';
+
+        *header++ = '\xcf';
+
+        for(int shift = 56; shift >= 0; shift -= 8) {
+            *header++ = static_cast<char>(stream.id >> shift);
+        }
+
+        *header++ = size == stream.remaining ? '\xc3' : '\xc2';
+
+        *header++ = '\xdb';
+
+        for(int shift = 24; shift >= 0; shift -= 8) {
+            *header++ = static_cast<char>(size >> shift);
+        }
+
+        m_messages.push_back(asio::buffer(stream.header));
+
+        size_t segments = 1;
+
+        for(size_t left = size; left != 0;) {
+            const asio::const_buffer& buffer = stream.buffers[stream.index];
+
+            const size_t bytes = std::min(asio::buffer_size(buffer) - stream.offset, left);
+
+            if(bytes) {
+                m_messages.push_back(asio::buffer(buffer + stream.offset, bytes));
+                segments++;
+            }
+
+            if((stream.offset += bytes) == asio::buffer_size(buffer)) {
+                stream.index++;
+                stream.offset = 0;
+            }
+
+            left -= bytes;
+        }
+
+        m_messages.push_back(asio::buffer(&kTrailer, 1));
+
+        stream.remaining -= size;
+
+        m_pending += kFragmentHeaderSize + 1;
+
+        return segments + 1;
+    }
+
+    void
+    coalesced() {
+        m_scheduled = false;
+        transmit();
+    }
+
+    void
+    transmit() {
+        if(m_state == states::flushing || m_messages.empty()) {
+            // Some other write has exceeded the coalescing budget and flushed the messages already.
+            return;
+        }
+
+        std::error_code ec;
+
+        issued();
+
+        // Try to write some data right away, as we don't have anything pending.
+        const size_t bytes_written = m_channel ?
+            m_channel->write_some(m_messages, ec) :
+            m_socket->write_some(m_messages, ec);
+
+        if(!ec) {
+            consume(bytes_written);
+        }
+
+        if(m_messages.empty()) {
+            m_state = states::idle;
+            return;
+        }
+
+        m_state = states::flushing;
+
+        send();
+    }
+
+    void
+    issued() {
+        m_writes++;
+
+        if(m_stats) {
+            m_stats->writes.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void
+    send() {
+        namespace ph = std::placeholders;
+
+        if(m_channel) {
+            return m_channel->async_wait_writable(std::bind(&writable_stream::resume,
+                this->shared_from_this(), ph::_1));
+        }
+
+        auto callback = std::bind(&writable_stream::flush, this->shared_from_this(), ph::_1,
+            ph::_2);
+
+        issued();
+
+        if(uring()) {
+            m_operation = m_uring->send(m_socket->native_handle(), m_messages, std::move(callback));
+            return;
+        }
+
+        m_socket->async_write_some(m_messages, std::move(callback));
+    }
+
+    void
+    resume(const std::error_code& ec) {
+        if(!m_socket->is_open() || ec) {
+            return flush(ec, 0);
+        }
+
+        std::error_code write_ec;
+
+        issued();
+
+        const size_t bytes_written = m_channel->write_some(m_messages, write_ec);
+
+        if(write_ec == asio::error::would_block) {
+            return send();
+        }
+
+        flush(write_ec, bytes_written);
+    }
+
     void
     flush(const std::error_code& ec, size_t bytes_written) {
+        m_operation = 0;
+
+        if(!m_socket->is_open()) {
+            // NOTE: Closing the socket doesn't cancel io_uring operations, so it's checked here to
+            // behave the same way as the reactor does.
+            return;
+        }
+
         if(ec) {
             if(ec == asio::error::operation_aborted) {
                 return;
             }
 
-            while(!m_handlers.empty()) {
-                m_socket->get_io_service().post(std::bind(m_handlers.front(), ec));
+            if(ec == asio::error::try_again) {
+                // Nothing has been sent, so send the same buffers through the reactor.
+                return send();
+            }
+
+            while(!m_queue.empty()) {
+                if(m_queue.front().handle) {
+                    m_socket->get_io_service().post(std::bind(m_queue.front().handle, ec));
+                }
 
-                m_messages.pop_front();
-                m_handlers.pop_front();
-                m_encoded_messages.pop_front();
+                m_queue.pop_front();
+            }
+
+            m_messages.clear();
+
+            while(!m_streams.empty()) {
+                if(m_streams.front().handle) {
+                    m_socket->get_io_service().post(std::bind(m_streams.front().handle, ec));
+                }
+
+                m_streams.pop_front();
+            }
+
+            m_pending = 0;
+            m_drained = nullptr;
+
+            m_charge.update(encoder.reserved());
+
+            if(m_failed) {
+                m_socket->get_io_service().post(std::bind(std::move(m_failed), ec));
+                m_failed = nullptr;
             }
 
             return;
         }
 
-        while(bytes_written) {
-            BOOST_ASSERT(!m_messages.empty() && !m_handlers.empty());
+        consume(bytes_written);
 
-            const size_t message_size = asio::buffer_size(m_messages.front());
+        if(m_messages.empty() && m_state == states::flushing) {
+            m_state = states::idle;
+            return;
+        }
+
+        send();
+    }
+
+    void
+    consume(size_t bytes_written) {
+        m_pending -= bytes_written;
+        m_transmitted += bytes_written;
+
+        // NOTE: Empty buffers are never reported as written, so they're completed here as well.
+        while(!m_messages.empty()) {
+            const size_t buffer_size = asio::buffer_size(m_messages.front());
 
-            if(message_size > bytes_written) {
+            if(buffer_size > bytes_written) {
                 m_messages.front() = m_messages.front() + bytes_written;
                 break;
             }
 
-            bytes_written -= message_size;
-
-            // Queue this block's handler for invocation.
-            m_socket->get_io_service().post(std::bind(m_handlers.front(), ec));
+            bytes_written -= buffer_size;
 
             m_messages.pop_front();
-            m_handlers.pop_front();
-            m_encoded_messages.pop_front();
+
+            pending_t& pending = m_queue.front();
+
+            if(--pending.segments != 0) {
+                continue;
+            }
+
+            if(pending.stream) {
+                stream_t* stream = pending.stream;
+
+                m_queue.pop_front();
+
+                if(stream->remaining) {
+                    // Goes after everything queued while the previous fragment was being written.
+                    m_queue.push_back(pending_t{message_type(), {}, fragment(*stream),
+                        handler_type(), stream});
+                } else {
+                    finish(stream);
+                }
+
+                continue;
+            }
+
+            if(pending.handle) {
+                // Queue this message's handler for invocation.
+                m_socket->get_io_service().post(std::bind(std::move(pending.handle),
+                    std::error_code()));
+            }
+
+            encoder.recycle(std::move(pending.encoded));
+
+            m_queue.pop_front();
         }
 
-        if(m_messages.empty() && m_state == states::flushing) {
-            m_state = states::idle;
-            return;
+        m_charge.update(m_pending + encoder.reserved());
+
+        if(m_drained && m_pending <= m_limit / 2) {
+            m_socket->get_io_service().post(std::move(m_drained));
+            m_drained = nullptr;
         }
+    }
 
-        namespace ph = std::placeholders;
+    void
+    finish(stream_t* stream) {
+        if(stream->handle) {
+            m_socket->get_io_service().post(std::bind(std::move(stream->handle),
+                std::error_code()));
+        }
+
+        encoder.recycle(std::move(stream->encoded));
 
-        m_socket->async_write_some(
-            m_messages,
-            std::bind(&writable_stream::flush, this->shared_from_this(), ph::_1, ph::_2)
-        );
+        m_streams.remove_if([stream](const stream_t& it) { return &it == stream; });
     }
 };
 
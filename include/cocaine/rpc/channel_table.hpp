@@ -0,0 +1,193 @@
+/*
+    Copyright (c) 2011-2014 Andrey Sibiryov <me@kobology.ru>
+    Copyright (c) 2011-2014 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef COCAINE_IO_CHANNEL_TABLE_HPP
+#define COCAINE_IO_CHANNEL_TABLE_HPP
+
+#include "cocaine/common.hpp"
+
+namespace cocaine { namespace io {
+
+// Open addressing hash table keyed by channel id. Since channel ids are allocated sequentially, the
+// id itself masked by the table size is used as the slot index, so live channels mostly occupy
+// consecutive slots and lookups rarely probe more than once. The values are stored inline.
+//
+// NOTE: Channel id zero is never valid, so it marks empty slots.
+
+template<class T>
+class channel_table {
+    struct slot_t {
+        uint64_t id;
+        T value;
+    };
+
+    static const size_t kInitialCapacity = 16;
+
+    std::vector<slot_t> m_slots;
+    size_t m_size;
+
+public:
+    channel_table():
+        m_slots(kInitialCapacity, slot_t()),
+        m_size(0)
+    { }
+
+    // NOTE: The returned pointers are invalidated by insertions and erasures.
+
+    auto
+    find(uint64_t id) -> T* {
+        for(size_t i = index(id); m_slots[i].id; i = next(i)) {
+            if(m_slots[i].id == id) {
+                return &m_slots[i].value;
+            }
+        }
+
+        return nullptr;
+    }
+
+    // Inserts a new value, the id must not be present in the table.
+    auto
+    insert(uint64_t id, T value) -> T& {
+        BOOST_ASSERT(id && !find(id));
+
+        if((m_size + 1) * 2 > m_slots.size()) {
+            rehash(m_slots.size() * 2);
+        }
+
+        size_t i = index(id);
+
+        while(m_slots[i].id) {
+            i = next(i);
+        }
+
+        m_slots[i].id = id;
+        m_slots[i].value = std::move(value);
+
+        ++m_size;
+
+        return m_slots[i].value;
+    }
+
+    bool
+    erase(uint64_t id) {
+        size_t hole = index(id);
+
+        while(m_slots[hole].id != id) {
+            if(!m_slots[hole].id) {
+                return false;
+            }
+
+            hole = next(hole);
+        }
+
+        // Shift the following entries of the probe sequence back, so that no tombstones are needed.
+        for(size_t i = next(hole); m_slots[i].id; i = next(i)) {
+            const size_t home = index(m_slots[i].id);
+
+            if(distance(home, i) >= distance(hole, i)) {
+                m_slots[hole] = std::move(m_slots[i]);
+                hole = i;
+            }
+        }
+
+        m_slots[hole].id = 0;
+        m_slots[hole].value = T();
+
+        --m_size;
+
+        // Give the slots back once a burst of channels is over. Halving leaves the table at most a
+        // quarter full, so that it doesn't flap between two sizes.
+        if(m_slots.size() > kInitialCapacity && m_size * 8 < m_slots.size()) {
+            rehash(m_slots.size() / 2);
+        }
+
+        return true;
+    }
+
+    void
+    clear() {
+        std::vector<slot_t>(kInitialCapacity, slot_t()).swap(m_slots);
+        m_size = 0;
+    }
+
+    template<class Visitor>
+    void
+    visit(Visitor visitor) const {
+        for(auto it = m_slots.begin(); it != m_slots.end(); ++it) {
+            if(it->id) visitor(it->id, it->value);
+        }
+    }
+
+    auto
+    size() const -> size_t {
+        return m_size;
+    }
+
+    auto
+    empty() const -> bool {
+        return m_size == 0;
+    }
+
+    auto
+    capacity() const -> size_t {
+        return m_slots.size();
+    }
+
+private:
+    auto
+    index(uint64_t id) const -> size_t {
+        return id & (m_slots.size() - 1);
+    }
+
+    auto
+    next(size_t i) const -> size_t {
+        return (i + 1) & (m_slots.size() - 1);
+    }
+
+    auto
+    distance(size_t from, size_t to) const -> size_t {
+        return (to - from) & (m_slots.size() - 1);
+    }
+
+    void
+    rehash(size_t capacity) {
+        std::vector<slot_t> slots(capacity, slot_t());
+
+        slots.swap(m_slots);
+
+        for(auto it = slots.begin(); it != slots.end(); ++it) {
+            if(!it->id) {
+                continue;
+            }
+
+            size_t i = index(it->id);
+
+            while(m_slots[i].id) {
+                i = next(i);
+            }
+
+            m_slots[i] = std::move(*it);
+        }
+    }
+};
+
+}} // namespace cocaine::io
+
+#endif
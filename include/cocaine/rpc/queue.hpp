@@ -81,6 +81,11 @@ public:
         m_upstream->template send<Event>(std::forward<Args>(args)...);
     }
 
+    bool
+    congested() const {
+        return m_upstream && m_upstream->congested();
+    }
+
     template<class OtherTag>
     void
     attach(upstream<OtherTag>&& upstream) {
@@ -24,13 +24,62 @@
 #include "cocaine/common.hpp"
 #include "cocaine/locked_ptr.hpp"
 
+#include "cocaine/rpc/channel_table.hpp"
+
 #include <asio/generic/stream_protocol.hpp>
 
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <map>
+#include <thread>
+
 #include "cocaine/rpc/asio/encoder.hpp"
 #include "cocaine/rpc/asio/decoder.hpp"
 
 namespace cocaine {
 
+namespace io {
+
+// Outbound queue overflow counters, shared by all the sessions of an execution unit.
+struct overflow_stats_t {
+    overflow_stats_t(): paused(0), signalled(0), disconnected(0) { }
+
+    std::atomic<uint64_t> paused;
+    std::atomic<uint64_t> signalled;
+    std::atomic<uint64_t> disconnected;
+};
+
+// Per-session share of the execution unit's reactor turns.
+struct fairness_stats_t {
+    fairness_stats_t(): turns(0), exhausted(0), frames(0), elapsed(0), quota(0) { }
+
+    // Reactor turns the session has handled some frames in, and the number of them it has ended
+    // with more frames buffered because of the limits.
+    uint64_t turns;
+    uint64_t exhausted;
+
+    // Frames handled and microseconds spent handling them in total.
+    uint64_t frames;
+    uint64_t elapsed;
+
+    // Current frame limit per turn. Lowered for the sessions which keep exhausting it.
+    size_t quota;
+};
+
+// Per-session channel table usage.
+struct channel_stats_t {
+    // Live channels and the number of slots allocated for them.
+    size_t active;
+    size_t capacity;
+
+    // Channels torn down, or never registered at all, because nothing could ever arrive on them.
+    uint64_t reclaimed;
+};
+
+} // namespace io
+
 class session_t:
     public std::enable_shared_from_this<session_t>
 {
@@ -38,35 +87,143 @@ class session_t:
     typedef protocol_type::endpoint endpoint_type;
 
     typedef io::transport<protocol_type> transport_type;
+    typedef io::writable_stream<protocol_type, io::encoder_t> writer_type;
 
     class pull_action_t;
     class push_action_t;
 
-    class channel_t;
+    struct channel_t {
+        io::dispatch_ptr_t dispatch;
+        io::upstream_ptr_t upstream;
+    };
 
-    typedef std::map<uint64_t, std::shared_ptr<channel_t>> channel_map_t;
+    typedef io::channel_table<channel_t> channel_map_t;
 
     // Log of last resort.
     const std::unique_ptr<logging::logger_t> log;
 
-    // The underlying connection.
-#if defined(__clang__)
+    // The underlying connection. Owned by the session until detached, after which it is destroyed
+    // on the execution unit thread once the current reactor handler completes. Thus the execution
+    // unit thread can use the raw pointer without any locking or reference counting.
     std::shared_ptr<transport_type> transport;
-#else
-    synchronized<std::shared_ptr<transport_type>> transport;
-#endif
+    std::atomic<transport_type*> attached;
+
+    // The execution unit reactor and its thread, which is known once the session starts pulling.
+    // Both change if the session is migrated to another execution unit.
+    std::atomic<asio::io_service*> reactor;
+    std::atomic<std::thread::id> owner;
+
+    // Handlers handed over from other threads. They're queued here rather than in the reactor, so
+    // that they're executed in order even if the session migrates while some of them are pending.
+    synchronized<std::deque<std::function<void()>>> mailbox;
+
+    // Cached, so that it's available without touching the connection from other threads.
+    endpoint_type peer;
 
     // Initial dispatch. Internally synchronized.
     const io::dispatch_ptr_t prototype;
 
-    // Virtual channels.
-    synchronized<channel_map_t> channels;
+    // Virtual channels. Only touched from the execution unit thread, other threads hand their
+    // changes over to the reactor.
+    channel_map_t channels;
+
+    // Number of channels in the table, republished by the execution unit thread after every change,
+    // so that it can be read from any thread.
+    std::atomic<size_t> active;
+
+    // Channel names as of the last time other threads have asked for them, assembled on the
+    // execution unit thread, so that the callers never wait for it.
+    synchronized<std::map<uint64_t, std::string>> snapshot;
+
+    // Number of channels reclaimed because their dispatch couldn't receive anything, i.e. mute.
+    std::atomic<uint64_t> reclaimed;
+
+    // Upstreams are allocated from this pool, so that short-lived channels don't hit the allocator.
+    const std::shared_ptr<io::block_pool_t> upstreams;
+
+    // Memory held by the connection's streams, passed on to the execution unit's budget. Charged
+    // only by the execution unit thread, but readable from any thread.
+    const std::shared_ptr<io::memory_budget_t> memory;
 
     // The maximum channel id processed by the session. Checking whether channel id is always higher
     // than the previous channel id is similar to an infinite TIME_WAIT timeout for TCP sockets. It
     // might be not the best approach, but since we have 2^64 possible channel ids, and not 2^16 TCP
     // ports available to us, it's good enough.
-    uint64_t max_channel_id;
+    std::atomic<uint64_t> max_channel_id;
+
+    // Outbound queue overflow handling. Apart from the congestion flag, which is checked by the
+    // producers, it's only touched from the session's execution unit thread.
+    io::overflow_policies overflow_policy;
+    std::shared_ptr<io::overflow_stats_t> overflow_stats;
+
+    bool paused;
+    bool pulling;
+
+    std::atomic<bool> congestion;
+
+public:
+    typedef std::function<void()> departed_handler_type;
+    typedef std::function<void(const std::shared_ptr<session_t>&, int)> arrived_handler_type;
+
+    // Sessions don't migrate more often than this, so that they don't bounce between units.
+    static const unsigned int kMigrationCooldown = 10;
+
+    // Default number of frames handled in one reactor turn.
+    static const size_t kFrameLimit = 64;
+
+    // Sessions exhausting their limits for this many turns in a row get their frame quota halved.
+    static const size_t kStrikeLimit = 4;
+
+private:
+    struct migration_t {
+        asio::io_service* target;
+        std::shared_ptr<io::buffer_pool_t> pool;
+
+        departed_handler_type departed;
+        arrived_handler_type arrived;
+    };
+
+    // Pending migration request, performed at the next safe point between frames. Only touched
+    // from the execution unit thread, as well as the counters below.
+    std::unique_ptr<migration_t> migration;
+
+    // Number of frames handled since the last reset_activity() call.
+    size_t frames;
+
+    // Invoked on the execution unit thread once the connection is destroyed after detachment.
+    std::function<void()> reclaim;
+
+    // When the session has arrived to its current execution unit, if it has ever been migrated.
+    std::chrono::steady_clock::time_point arrival;
+
+    // Configured per-turn limits and the number of consecutive turns they have been exhausted for.
+    size_t frame_limit;
+    std::chrono::microseconds time_limit;
+    size_t strikes;
+
+    io::fairness_stats_t fairness_stats;
+
+    // Fragment size for the large outbound messages, applied once the client asks for interleaving.
+    size_t interleaving;
+
+    // Idle connection detection, driven by the execution unit's periodic sweep. The activity is
+    // detected by comparing the transport byte counters with the ones seen by the previous sweep,
+    // so that nothing is done per frame.
+    struct liveness_t {
+        // Zero disables the corresponding check.
+        std::chrono::seconds read_timeout;
+        std::chrono::seconds write_timeout;
+        std::chrono::seconds heartbeat;
+
+        uint64_t received;
+        uint64_t transmitted;
+
+        // When something was last received and sent, and when the outbound queue last made any
+        // progress or was empty.
+        std::chrono::steady_clock::time_point read;
+        std::chrono::steady_clock::time_point sent;
+        std::chrono::steady_clock::time_point flushed;
+    } liveness;
 
 public:
     session_t(std::unique_ptr<logging::logger_t> log,
@@ -74,12 +231,42 @@ public:
 
     // Observers
 
+    // Open channels with their dispatch names. Exact on the session's execution unit thread. Other
+    // threads get the snapshot taken by the previous such call, and schedule a fresh one.
     auto
     active_channels() const -> std::map<uint64_t, std::string>;
 
+    // Number of open channels. Safe to call from any thread.
+    auto
+    channel_count() const -> size_t;
+
+    // Bytes held in the read ring, the outbound queue and the spare packing buffers. Safe to call
+    // from any thread.
     std::size_t
     memory_pressure() const;
 
+    // Number of frames handled since the last reset_activity() call, i.e. the last balancing pass.
+    auto
+    activity() const -> size_t;
+
+    void
+    reset_activity();
+
+    bool
+    is_attached() const;
+
+    // Whether the client can't keep up with the outbound messages, so the producers should hold on.
+    bool
+    congested() const;
+
+    // NOTE: Only consistent on the session's execution unit thread.
+
+    auto
+    fairness() const -> const io::fairness_stats_t&;
+
+    auto
+    channel_stats() const -> io::channel_stats_t;
+
     auto
     name() const -> std::string;
 
@@ -97,6 +284,52 @@ public:
     void
     push(io::encoder_t::message_type&& message);
 
+    // NOTE: Requests the session to be moved to another execution unit at the next safe point, i.e.
+    // between frames with nothing buffered or being written. The departure handler is invoked on
+    // this thread once the session has left, while the arrival one is invoked on the target thread
+    // along with the new connection descriptor. Must be called on the session's execution unit
+    // thread. Returns false if the session has been migrated too recently.
+
+    bool
+    migrate(asio::io_service& target, const std::shared_ptr<io::buffer_pool_t>& pool,
+            departed_handler_type departed, arrived_handler_type arrived);
+
+    // NOTE: Must be called before the session starts pulling.
+
+    void
+    overflow(io::overflow_policies policy, const std::shared_ptr<io::overflow_stats_t>& stats);
+
+    // NOTE: Limits the frames handled in one reactor turn by number and, unless it's zero, by time.
+    // Must be called before the session starts pulling.
+
+    void
+    fairness(size_t quota, std::chrono::microseconds budget);
+
+    // NOTE: Drops the connection if nothing is received for the read timeout or if the outbound
+    // messages are stuck for the write timeout, and sends a heartbeat if nothing has been sent for
+    // the heartbeat interval. Zero disables either. Must be called before the session starts
+    // pulling.
+
+    void
+    timeouts(std::chrono::seconds read, std::chrono::seconds write, std::chrono::seconds heartbeat);
+
+    // NOTE: Outbound messages larger than the fragment size are interleaved with the other ones
+    // once the client has sent control::interleave, zero disables it. Must be called before the
+    // session starts pulling.
+
+    void
+    interleave(size_t fragment);
+
+    // Performs the idle connection checks. Must be called on the execution unit thread.
+    void
+    sweep(std::chrono::steady_clock::time_point now);
+
+    // NOTE: Must be called on the execution unit thread. The handler is dropped when the session
+    // migrates, so the new execution unit has to set its own one.
+
+    void
+    detached(std::function<void()> handle);
+
     // NOTE: Detaching a session destroys the connection but not necessarily the session itself, as
     // it might be still in use by shared upstreams even in other threads. In other words, this does
     // not guarantee that the session will be actually deleted, but it's fine, since the connection
@@ -106,6 +339,33 @@ public:
     detach(const std::error_code& ec);
 
 private:
+    // Whether the caller runs on the session's execution unit thread.
+    bool
+    is_owner() const;
+
+    // Binds the session to the calling execution unit thread.
+    void
+    adopt();
+
+    // Hands the handler over to the session's execution unit thread.
+    void
+    post(std::function<void()> handler);
+
+    void
+    deliver(asio::io_service* target);
+
+    // Performs the pending migration. Returns false if it's not safe to migrate yet.
+    bool
+    depart(transport_type* ptr);
+
+    // Whether the current turn, started at the given time, has run out of its time limit.
+    bool
+    overran(std::chrono::steady_clock::time_point started) const;
+
+    // Accounts the turn and adjusts the frame quota for the next one.
+    void
+    yielded(size_t handled, std::chrono::steady_clock::time_point started, bool exhausted);
+
     void
     handle(const io::decoder_t::message_type& message);
 
@@ -116,6 +376,27 @@ private:
 
     void
     revoke(uint64_t channel_id);
+
+    // Discards all the channels on session detachment.
+    void
+    discard(const std::error_code& ec);
+
+    // Applies the overflow policy once the outbound queue has gone over the limit.
+    void
+    overload(transport_type* ptr);
+
+    void
+    drained();
+
+    // Writes the message to the connection, must be called on the execution unit thread.
+    void
+    write(io::encoder_t::message_type&& message);
+
+    void
+    sent(const std::error_code& ec);
+
+    void
+    failed(const std::error_code& ec);
 };
 
 template<class Protocol>
@@ -68,6 +68,13 @@ struct streamed {
         return *this;
     }
 
+    // Whether the client can't keep up with the stream, so the producer should hold off writing for
+    // a while. Only reported for services configured with the "signal" overflow policy.
+    bool
+    congested() const {
+        return outbox->synchronize()->congested();
+    }
+
     template<class UpstreamType>
     void
     attach(UpstreamType&& upstream) {
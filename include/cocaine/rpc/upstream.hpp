@@ -45,6 +45,11 @@ public:
     void
     send(Args&&... args);
 
+    bool
+    congested() const {
+        return session->congested();
+    }
+
     /* none_t if upstream belongs to server side */
     boost::optional<trace_t> client_trace;
 };
@@ -32,24 +32,40 @@
 
 #include <blackhole/logger.hpp>
 
+#include <asio/detail/socket_option.hpp>
+
 using namespace cocaine;
 using namespace cocaine::io;
 
 using namespace asio;
 using ip::tcp;
 
+namespace {
+
+typedef asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT> reuse_port;
+
+} // namespace
+
 // Actor internals
 
 class actor_t::accept_action_t:
     public std::enable_shared_from_this<accept_action_t>
 {
     actor_t *const parent;
-    tcp::socket    socket;
+
+    // The connection is accepted directly onto the reactor of the execution unit it will be
+    // attached to, so that it doesn't have to be cloned there afterwards.
+    execution_unit_t* engine;
+    std::unique_ptr<tcp::socket> socket;
+
+    // Whether to pick the execution units from the busy-polling pool.
+    const bool polling;
 
 public:
-    accept_action_t(actor_t *const parent_):
+    accept_action_t(actor_t *const parent_, bool polling_):
         parent(parent_),
-        socket(*parent->m_asio)
+        engine(nullptr),
+        polling(polling_)
     { }
 
     void
@@ -68,23 +84,24 @@ actor_t::accept_action_t::operator()() {
             return;
         }
 
-        ptr->async_accept(socket, std::bind(&accept_action_t::finalize, shared_from_this(),
+        engine = &parent->m_context.engine(polling);
+        socket = std::make_unique<tcp::socket>(engine->asio());
+
+        ptr->async_accept(*socket, std::bind(&accept_action_t::finalize, shared_from_this(),
             std::placeholders::_1));
     });
 }
 
 void
 actor_t::accept_action_t::finalize(const std::error_code& ec) {
-    // Prepare the internal socket object for consequential operations by moving its contents to a
-    // heap-allocated object, which in turn might be attached to an engine.
-    auto ptr = std::make_unique<tcp::socket>(std::move(socket));
+    auto ptr = std::move(socket);
 
     switch(ec.value()) {
     case 0:
         COCAINE_LOG_DEBUG(parent->m_log, "accepted connection on fd {:d}", ptr->native_handle());
 
         try {
-            parent->m_context.engine().attach(std::move(ptr), parent->m_prototype);
+            engine->attach(std::move(ptr), parent->m_prototype);
         } catch(const std::system_error& e) {
             COCAINE_LOG_ERROR(parent->m_log, "unable to attach connection to engine: {}",
                 error::to_string(e));
@@ -107,6 +124,101 @@ actor_t::accept_action_t::finalize(const std::error_code& ec) {
     operator()();
 }
 
+class actor_t::shard_action_t:
+    public std::enable_shared_from_this<shard_action_t>
+{
+    execution_unit_t& engine;
+
+    // NOTE: Shards might outlive the actor for a bit, as they're stopped asynchronously, so they
+    // don't reference it at all.
+    const std::shared_ptr<tcp::acceptor> acceptor;
+    const dispatch_ptr_t prototype;
+    const std::unique_ptr<logging::logger_t> log;
+
+    std::unique_ptr<tcp::socket> socket;
+
+public:
+    // Maximum number of connections accepted on a single reactor wakeup.
+    static const size_t kBatchSize = 64;
+
+    shard_action_t(actor_t *const parent, execution_unit_t& engine_,
+                   const std::shared_ptr<tcp::acceptor>& acceptor_)
+    :
+        engine(engine_),
+        acceptor(acceptor_),
+        prototype(parent->m_prototype),
+        log(parent->m_context.log("core/asio", {{"service", prototype->name()}}))
+    { }
+
+    void
+    operator()();
+
+private:
+    void
+    finalize(const std::error_code& ec);
+
+    void
+    attach(std::unique_ptr<tcp::socket> ptr);
+};
+
+void
+actor_t::shard_action_t::operator()() {
+    socket = std::make_unique<tcp::socket>(engine.asio());
+
+    acceptor->async_accept(*socket, std::bind(&shard_action_t::finalize, shared_from_this(),
+        std::placeholders::_1));
+}
+
+void
+actor_t::shard_action_t::finalize(const std::error_code& ec) {
+    switch(ec.value()) {
+    case 0:
+        attach(std::move(socket));
+        break;
+
+    case asio::error::operation_aborted:
+        return;
+
+    default:
+        COCAINE_LOG_ERROR(log, "unable to accept connection: [{:d}] {}", ec.value(),
+            ec.message());
+        break;
+    }
+
+    // Drain the accept queue without going through the reactor for every connection. The acceptor
+    // is non-blocking, so this stops as soon as the queue is empty.
+    for(size_t i = 1; i < kBatchSize; ++i) {
+        auto ptr = std::make_unique<tcp::socket>(engine.asio());
+
+        std::error_code error;
+
+        if(acceptor->accept(*ptr, error)) {
+            if(error != asio::error::would_block && error != asio::error::try_again) {
+                COCAINE_LOG_ERROR(log, "unable to accept connection: [{:d}] {}", error.value(),
+                    error.message());
+            }
+
+            break;
+        }
+
+        attach(std::move(ptr));
+    }
+
+    operator()();
+}
+
+void
+actor_t::shard_action_t::attach(std::unique_ptr<tcp::socket> ptr) {
+    COCAINE_LOG_DEBUG(log, "accepted connection on fd {:d}", ptr->native_handle());
+
+    try {
+        // The socket already belongs to the engine's reactor, so the session starts right away.
+        engine.attach(std::move(ptr), prototype);
+    } catch(const std::system_error& e) {
+        COCAINE_LOG_ERROR(log, "unable to attach connection to engine: {}", error::to_string(e));
+    }
+}
+
 // Actor
 
 actor_t::actor_t(context_t& context, const std::shared_ptr<io_service>& asio,
@@ -193,7 +305,13 @@ actor_t::prototype() const {
 
 void
 actor_t::run() {
-    m_acceptor.apply([this](std::unique_ptr<tcp::acceptor>& ptr) {
+    const auto& transports = m_context.config.network.transports;
+    const auto  transport  = transports.find(m_prototype->name());
+
+    const bool reuseport = transport != transports.end() && transport->second.reuseport;
+    const bool polling   = transport != transports.end() && transport->second.polling;
+
+    m_acceptor.apply([&](std::unique_ptr<tcp::acceptor>& ptr) {
         std::error_code ec;
         tcp::endpoint endpoint;
 
@@ -205,7 +323,20 @@ actor_t::run() {
         }
 
         try {
-            ptr = std::make_unique<tcp::acceptor>(*m_asio, endpoint);
+            if(!reuseport) {
+                ptr = std::make_unique<tcp::acceptor>(*m_asio, endpoint);
+            } else {
+                // NOTE: This acceptor is bound but never listens, so it only holds the port, while
+                // the kernel spreads the connections among the per-engine acceptors.
+                ptr = std::make_unique<tcp::acceptor>(*m_asio);
+
+                ptr->open(endpoint.protocol());
+                ptr->set_option(tcp::acceptor::reuse_address(true));
+                ptr->set_option(reuse_port(true));
+                ptr->bind(endpoint);
+
+                spread(ptr->local_endpoint(), polling);
+            }
         } catch(const std::system_error& e) {
             COCAINE_LOG_ERROR(m_log, "unable to bind local endpoint {} for service: {}", endpoint, error::to_string(e));
             throw;
@@ -214,12 +345,17 @@ actor_t::run() {
         COCAINE_LOG_INFO(m_log, "exposing service on local endpoint {}", ptr->local_endpoint(ec));
     });
 
-    m_asio->post(std::bind(&accept_action_t::operator(),
-        std::make_shared<accept_action_t>(this)
-    ));
+    if(!reuseport) {
+        m_asio->post(std::bind(&accept_action_t::operator(),
+            std::make_shared<accept_action_t>(this, polling)
+        ));
+    }
 
     // The post() above won't be executed until this thread is started.
-    m_chamber = std::make_unique<chamber_t>(m_prototype->name(), m_asio);
+    const auto& affinity = m_context.config.network.affinity;
+
+    m_chamber = std::make_unique<chamber_t>(m_prototype->name(), m_asio,
+        affinity_t{affinity.services, affinity.numa});
 }
 
 void
@@ -231,6 +367,8 @@ actor_t::terminate() {
     // Does not block, unlike the one in execution_unit_t's destructors.
     m_chamber = nullptr;
 
+    retract();
+
     m_acceptor.apply([this](std::unique_ptr<tcp::acceptor>& ptr) {
         std::error_code ec;
         const auto endpoint = ptr->local_endpoint(ec);
@@ -246,3 +384,52 @@ actor_t::terminate() {
     // Mark this service's port as free.
     m_context.mapper.retain(m_prototype->name());
 }
+
+void
+actor_t::spread(const tcp::endpoint& endpoint, bool polling) {
+    const auto& engines = m_context.engines(polling);
+
+    try {
+        for(auto it = engines.begin(); it != engines.end(); ++it) {
+            auto& engine = **it;
+
+            auto acceptor = std::make_shared<tcp::acceptor>(engine.asio());
+
+            acceptor->open(endpoint.protocol());
+            acceptor->set_option(tcp::acceptor::reuse_address(true));
+            acceptor->set_option(reuse_port(true));
+            acceptor->bind(endpoint);
+            acceptor->listen();
+
+            // Required to drain the accept queue in batches.
+            acceptor->non_blocking(true);
+
+            m_shards.push_back(acceptor);
+
+            engine.asio().post(std::bind(&shard_action_t::operator(),
+                std::make_shared<shard_action_t>(this, engine, acceptor)
+            ));
+        }
+    } catch(const std::system_error&) {
+        retract();
+        throw;
+    }
+
+    COCAINE_LOG_DEBUG(m_log, "accepting connections on {:d} execution unit(s)", m_shards.size());
+}
+
+void
+actor_t::retract() {
+    for(auto it = m_shards.begin(); it != m_shards.end(); ++it) {
+        const auto acceptor = *it;
+
+        // Shard acceptors have to be closed on their own threads, which aborts the pending accept
+        // operations.
+        acceptor->get_io_service().post([acceptor] {
+            std::error_code ec;
+            acceptor->close(ec);
+        });
+    }
+
+    m_shards.clear();
+}
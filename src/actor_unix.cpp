@@ -18,13 +18,17 @@ namespace ph = std::placeholders;
 class unix_actor_t::accept_action_t:
     public std::enable_shared_from_this<accept_action_t>
 {
-    unix_actor_t *const   parent;
-    protocol_type::socket socket;
+    unix_actor_t *const parent;
+
+    // The connection is accepted directly onto the reactor of the execution unit it will be
+    // attached to, so that it doesn't have to be cloned there afterwards.
+    execution_unit_t* engine;
+    std::unique_ptr<protocol_type::socket> socket;
 
 public:
     accept_action_t(unix_actor_t *const parent):
         parent(parent),
-        socket(*parent->m_asio)
+        engine(nullptr)
     {}
 
     void
@@ -37,16 +41,17 @@ public:
 
             using namespace std::placeholders;
 
-            ptr->async_accept(socket, std::bind(&accept_action_t::finalize, shared_from_this(), ph::_1));
+            engine = &parent->m_context.engine();
+            socket = std::make_unique<protocol_type::socket>(engine->asio());
+
+            ptr->async_accept(*socket, std::bind(&accept_action_t::finalize, shared_from_this(), ph::_1));
         });
     }
 
 private:
     void
     finalize(const std::error_code& ec) {
-        // Prepare the internal socket object for consequential operations by moving its contents to a
-        // heap-allocated object, which in turn might be attached to an engine.
-        auto ptr = std::make_unique<protocol_type::socket>(std::move(socket));
+        auto ptr = std::move(socket);
 
         switch(ec.value()) {
         case 0:
@@ -54,7 +59,7 @@ private:
 
             try {
                 auto base = parent->fact();
-                auto session = parent->m_context.engine().attach(std::move(ptr), base);
+                auto session = engine->attach(std::move(ptr), base);
                 parent->bind(base, std::move(session));
             } catch(const std::system_error& e) {
                 COCAINE_LOG_ERROR(parent->m_log, "unable to attach connection to engine: {}",
@@ -118,7 +123,10 @@ unix_actor_t::run() {
     ));
 
     // The post() above won't be executed until this thread is started.
-    m_chamber = std::make_unique<io::chamber_t>(m_prototype->name(), m_asio);
+    const auto& affinity = m_context.config.network.affinity;
+
+    m_chamber = std::make_unique<io::chamber_t>(m_prototype->name(), m_asio,
+        io::affinity_t{affinity.services, affinity.numa});
 }
 
 void
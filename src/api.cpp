@@ -26,6 +26,51 @@ namespace cocaine { namespace api {
 
 // Storage
 
+namespace {
+
+class buffered_writer_t:
+    public storage_t::writer_t
+{
+    storage_t& parent;
+
+    const std::string collection;
+    const std::string key;
+    const std::vector<std::string> tags;
+
+    std::string blob;
+
+public:
+    buffered_writer_t(storage_t& parent_, const std::string& collection_, const std::string& key_,
+                      const std::vector<std::string>& tags_)
+    :
+        parent(parent_),
+        collection(collection_),
+        key(key_),
+        tags(tags_)
+    { }
+
+    virtual
+    void
+    write(const std::string& chunk) {
+        blob.append(chunk);
+    }
+
+    virtual
+    void
+    commit() {
+        parent.write(collection, key, blob, tags);
+    }
+};
+
+} // namespace
+
+std::unique_ptr<storage_t::writer_t>
+storage_t::open(const std::string& collection, const std::string& key,
+                const std::vector<std::string>& tags)
+{
+    return std::make_unique<buffered_writer_t>(*this, collection, key, tags);
+}
+
 category_traits<storage_t>::ptr_type
 storage(context_t& context, const std::string& name) {
     auto it = context.config.storages.find(name);
@@ -20,11 +20,23 @@
 
 #include "cocaine/detail/chamber.hpp"
 
+#include "cocaine/format.hpp"
+
+#include <cerrno>
+#include <future>
 #include <iomanip>
+#include <set>
 #include <sstream>
 
+#include <boost/filesystem/operations.hpp>
+
 #if defined(__linux__)
+    #include <linux/mempolicy.h>
+    #include <pthread.h>
+    #include <sched.h>
     #include <sys/prctl.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
 #elif defined(__APPLE__)
     #include <pthread.h>
 #endif
@@ -38,15 +50,41 @@ using namespace cocaine::io;
 class chamber_t::named_runnable_t {
     const std::string name;
     const std::shared_ptr<asio::io_service>& asio;
+    const affinity_t affinity;
+    const polling_t polling;
+
+    // Fulfilled once the thread is placed, or with the reason it couldn't be.
+    const std::shared_ptr<std::promise<void>> placed;
+
+    polling_stats_t *const stats;
 
 public:
-    named_runnable_t(const std::string& name_, const std::shared_ptr<asio::io_service>& asio_):
+    // Number of reactor polls between publishing the polling stats.
+    static const size_t kPublishInterval = 1024;
+
+    named_runnable_t(const std::string& name_,
+                     const std::shared_ptr<asio::io_service>& asio_,
+                     const affinity_t& affinity_,
+                     const polling_t& polling_,
+                     const std::shared_ptr<std::promise<void>>& placed_,
+                     polling_stats_t *const stats_):
         name(name_),
-        asio(asio_)
+        asio(asio_),
+        affinity(affinity_),
+        polling(polling_),
+        placed(placed_),
+        stats(stats_)
     { }
 
     void
     operator()() const;
+
+private:
+    void
+    place() const;
+
+    void
+    spin() const;
 };
 
 void
@@ -61,7 +99,148 @@ chamber_t::named_runnable_t::operator()() const {
     pthread_setname_np(name.c_str());
 #endif
 
-    asio->run();
+    try {
+        place();
+    } catch(...) {
+        return placed->set_exception(std::current_exception());
+    }
+
+    placed->set_value();
+
+    if(polling.enabled) {
+        spin();
+    } else {
+        asio->run();
+    }
+}
+
+void
+chamber_t::named_runnable_t::spin() const {
+    typedef std::chrono::steady_clock clock_type;
+
+    clock_type::duration working(0), spinning(0), parked(0);
+
+    auto publish = [&] {
+        stats->working  += std::chrono::duration_cast<std::chrono::nanoseconds>(working).count();
+        stats->spinning += std::chrono::duration_cast<std::chrono::nanoseconds>(spinning).count();
+        stats->parked   += std::chrono::duration_cast<std::chrono::nanoseconds>(parked).count();
+
+        working = spinning = parked = clock_type::duration(0);
+    };
+
+    auto mark = clock_type::now();
+    auto idle = mark;
+
+    // NOTE: The reactor stops by itself once it runs out of work, the same way run() returns.
+    for(size_t polls = 1; !asio->stopped(); ++polls) {
+        const bool handled = asio->poll_one() != 0;
+        auto now = clock_type::now();
+
+        if(handled) {
+            working += now - mark;
+            idle = now;
+        } else {
+            spinning += now - mark;
+
+            if(polling.spin.count() != 0 && now - idle >= polling.spin) {
+                // Don't leave the stats stale for as long as the thread might be parked.
+                publish();
+
+                asio->run_one();
+
+                idle = clock_type::now();
+                parked += idle - now;
+                now = idle;
+            }
+        }
+
+        mark = now;
+
+        if(polls % kPublishInterval == 0) {
+            publish();
+        }
+    }
+
+    publish();
+}
+
+namespace {
+
+#if defined(__linux__)
+// Returns the NUMA node the specified CPU belongs to, or -1 if the kernel doesn't expose it.
+int
+node_of(unsigned int cpu) {
+    namespace fs = boost::filesystem;
+
+    const auto path = fs::path(cocaine::format("/sys/devices/system/cpu/cpu%d", cpu));
+
+    boost::system::error_code ec;
+
+    for(fs::directory_iterator it(path, ec), end; !ec && it != end; it.increment(ec)) {
+        const auto entry = it->path().filename().string();
+
+        if(entry.size() > 4 && entry.compare(0, 4, "node") == 0) {
+            try {
+                return std::stoi(entry.substr(4));
+            } catch(const std::logic_error&) {
+                continue;
+            }
+        }
+    }
+
+    return -1;
+}
+#endif
+
+} // namespace
+
+void
+chamber_t::named_runnable_t::place() const {
+#if defined(__linux__)
+    if(affinity.cpus.empty()) {
+        return;
+    }
+
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+
+    for(auto it = affinity.cpus.begin(); it != affinity.cpus.end(); ++it) {
+        CPU_SET(*it, &cpus);
+    }
+
+    if(const int rv = ::pthread_setaffinity_np(::pthread_self(), sizeof(cpus), &cpus)) {
+        throw std::system_error(rv, std::system_category(), "unable to pin the thread");
+    }
+
+    if(!affinity.numa) {
+        return;
+    }
+
+    std::set<int> nodes;
+
+    for(auto it = affinity.cpus.begin(); it != affinity.cpus.end(); ++it) {
+        nodes.insert(node_of(*it));
+    }
+
+    // NOTE: The kernel already allocates on the local node by default, but falls back to the other
+    // nodes silently once it's short on memory and keeps doing so for the pages which were touched
+    // on a different CPU. MPOL_PREFERRED makes every allocation of this thread try the pinned node
+    // first. With several nodes there's no single preferred one, so the default policy is kept.
+    if(nodes.size() != 1 || *nodes.begin() < 0) {
+        return;
+    }
+
+    const auto bits = sizeof(unsigned long) * 8;
+    const auto node = static_cast<size_t>(*nodes.begin());
+
+    std::vector<unsigned long> mask(node / bits + 1);
+    mask[node / bits] |= 1UL << (node % bits);
+
+    // NOTE: The kernel treats the node count as one past the last node, the same way libnuma does.
+    if(::syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask.data(), mask.size() * bits + 1) != 0) {
+        throw std::system_error(errno, std::system_category(), "unable to set the memory policy");
+    }
+#endif
 }
 
 class chamber_t::stats_periodic_action_t:
@@ -138,20 +317,34 @@ chamber_t::stats_periodic_action_t::finalize(const std::error_code& ec) {
 
 namespace bpt = boost::posix_time;
 
-chamber_t::chamber_t(const std::string& name_, const std::shared_ptr<asio::io_service>& asio_):
+chamber_t::chamber_t(const std::string& name_, const std::shared_ptr<asio::io_service>& asio_,
+                     const affinity_t& affinity, const polling_t& polling):
     name(name_),
     asio(asio_),
     cron(*asio_),
     load_acc1(boost::accumulators::rolling_window_size = 60 / kCollectionInterval)
 {
-    asio->post(std::bind(&stats_periodic_action_t::operator(),
-        std::make_shared<stats_periodic_action_t>(this, bpt::seconds(kCollectionInterval))
-    ));
-
     // Bootstrap the rolling mean to avoid showing NaNs to the first clients.
     (*load_acc1.synchronize())(0.0f);
 
-    thread = std::make_unique<boost::thread>(named_runnable_t(name, asio));
+    // Keeps the reactor from running out of work until the stats action is posted below, because
+    // nothing is posted until the thread is known to be placed correctly.
+    const asio::io_service::work guard(*asio);
+    auto placed = std::make_shared<std::promise<void>>();
+
+    thread = std::make_unique<boost::thread>(named_runnable_t(name, asio, affinity, polling, placed,
+        &polling_stats));
+
+    try {
+        placed->get_future().get();
+    } catch(...) {
+        thread->join();
+        throw;
+    }
+
+    asio->post(std::bind(&stats_periodic_action_t::operator(),
+        std::make_shared<stats_periodic_action_t>(this, bpt::seconds(kCollectionInterval))
+    ));
 }
 
 chamber_t::~chamber_t() {
@@ -28,6 +28,7 @@
 #include "cocaine/logging.hpp"
 
 #include "cocaine/rpc/actor.hpp"
+#include "cocaine/rpc/asio/memory_budget.hpp"
 
 #include <boost/spirit/include/karma_char.hpp>
 #include <boost/spirit/include/karma_generate.hpp>
@@ -38,6 +39,8 @@
 #include <blackhole/scope/holder.hpp>
 #include <blackhole/wrapper.hpp>
 
+#include <random>
+
 #include "cocaine/logging.hpp"
 
 using namespace cocaine;
@@ -190,16 +193,57 @@ struct utilization_t {
 } // namespace
 
 execution_unit_t&
-context_t::engine() {
-    return **std::min_element(m_pool.begin(), m_pool.end(), utilization_t());
+context_t::engine(bool polling) {
+    const auto& pool = polling ? m_polling : m_pool;
+
+    if(config.network.balancer == config_t::balancers::utilization || pool.size() < 2) {
+        return **std::min_element(pool.begin(), pool.end(), utilization_t());
+    }
+
+    static thread_local std::minstd_rand generator(std::random_device{}());
+
+    std::uniform_int_distribution<size_t> distribution(0, pool.size() - 1);
+
+    const auto lhs = distribution(generator);
+    auto       rhs = distribution(generator);
+
+    // Pick two distinct units, so that the choice is never degenerate.
+    if(lhs == rhs) {
+        rhs = (rhs + 1) % pool.size();
+    }
+
+    return pool[lhs]->load() <= pool[rhs]->load() ? *pool[lhs] : *pool[rhs];
+}
+
+const std::vector<std::unique_ptr<execution_unit_t>>&
+context_t::engines(bool polling) const {
+    return polling ? m_polling : m_pool;
+}
+
+const std::shared_ptr<io::memory_budget_t>&
+context_t::memory() const {
+    return m_memory;
 }
 
 void
 context_t::bootstrap() {
     COCAINE_LOG_INFO(m_log, "starting {:d} execution unit(s)", config.network.pool);
 
+    m_memory = std::make_shared<io::memory_budget_t>(config.network.memory.process);
+
     while(m_pool.size() != config.network.pool) {
-        m_pool.emplace_back(std::make_unique<execution_unit_t>(*this));
+        m_pool.emplace_back(std::make_unique<execution_unit_t>(*this, m_pool.size(), false));
+    }
+
+    if(config.network.polling.pool) {
+        COCAINE_LOG_INFO(m_log, "starting {:d} busy-polling execution unit(s)",
+            config.network.polling.pool);
+    }
+
+    // NOTE: Indices continue after the regular units, so that they're pinned to the next CPUs.
+    while(m_polling.size() != config.network.polling.pool) {
+        m_polling.emplace_back(std::make_unique<execution_unit_t>(*this,
+            m_pool.size() + m_polling.size(), true));
     }
 
     COCAINE_LOG_INFO(m_log, "starting {:d} service(s)", config.services.size());
@@ -276,9 +320,10 @@ context_t::terminate() {
     // app invocation services from the node service, should be dead by now.
     BOOST_ASSERT(m_services->empty());
 
-    COCAINE_LOG_INFO(m_log, "stopping {:d} execution unit(s)", m_pool.size());
+    COCAINE_LOG_INFO(m_log, "stopping {:d} execution unit(s)", m_pool.size() + m_polling.size());
 
     m_pool.clear();
+    m_polling.clear();
 
     // Destroy the service objects.
     actors.clear();
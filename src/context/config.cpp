@@ -31,6 +31,8 @@
 #include <boost/filesystem/operations.hpp>
 #include <boost/thread/thread.hpp>
 
+#include <sstream>
+
 #include "rapidjson/reader.h"
 
 using namespace cocaine;
@@ -199,6 +201,155 @@ struct dynamic_converter<config_t::component_t> {
     }
 };
 
+template<>
+struct dynamic_converter<config_t::transport_t> {
+    typedef config_t::transport_t result_type;
+
+    static
+    result_type
+    convert(const dynamic_t& from) {
+        return config_t::transport_t {
+            from.as_object().at("coalesce", 0u).as_uint(),
+            from.as_object().at("mirrored", false).as_bool(),
+            from.as_object().at("limit", 0u).as_uint(),
+            overflow(from.as_object().at("overflow", "pause").as_string()),
+            from.as_object().at("reuseport", false).as_bool(),
+            from.as_object().at("polling", false).as_bool(),
+            from.as_object().at("max-frame-size", 0u).as_uint(),
+            from.as_object().at("read-idle", 0u).as_uint(),
+            from.as_object().at("write-idle", 0u).as_uint(),
+            from.as_object().at("heartbeat", 0u).as_uint(),
+            from.as_object().at("interleave", 0u).as_uint(),
+            from.as_object().at("shared-memory", 0u).as_uint()
+        };
+    }
+
+    static inline
+    io::overflow_policies
+    overflow(const std::string& policy) {
+        static std::map<std::string, io::overflow_policies> policies{
+            {"pause",      io::overflow_policies::pause     },
+            {"signal",     io::overflow_policies::signal    },
+            {"disconnect", io::overflow_policies::disconnect}
+        };
+
+        try {
+            return policies.at(policy);
+        } catch (const std::out_of_range&) {
+            throw cocaine::error_t("overflow policy \"%s\" not found", policy);
+        }
+    }
+};
+
+template<>
+struct dynamic_converter<config_t::affinity_t> {
+    typedef config_t::affinity_t result_type;
+
+    static
+    result_type
+    convert(const dynamic_t& from) {
+        return config_t::affinity_t {
+            cpus(from.as_object().at("engines",  dynamic_t::array_t())),
+            cpus(from.as_object().at("services", dynamic_t::array_t())),
+            from.as_object().at("numa", false).as_bool()
+        };
+    }
+
+    // CPU sets are either arrays of CPU numbers or strings in the cpuset(7) list format, for
+    // example "0-3,8,10-11".
+    static
+    std::vector<unsigned int>
+    cpus(const dynamic_t& from) {
+        std::vector<unsigned int> result;
+
+        if(from.is_array()) {
+            result = from.to<std::vector<unsigned int>>();
+        } else {
+            std::istringstream stream(from.as_string());
+            std::string range;
+
+            while(std::getline(stream, range, ',')) {
+                unsigned int first, last;
+                char dash;
+
+                std::istringstream bounds(range);
+
+                if(!(bounds >> first)) {
+                    throw cocaine::error_t("CPU list \"%s\" is malformed", from.as_string());
+                } else if(!(bounds >> dash)) {
+                    last = first;
+                } else if(dash != '-' || !(bounds >> last) || last < first) {
+                    throw cocaine::error_t("CPU list \"%s\" is malformed", from.as_string());
+                }
+
+                for(unsigned int cpu = first; cpu <= last; ++cpu) {
+                    result.push_back(cpu);
+                }
+            }
+        }
+
+        const auto limit = boost::thread::hardware_concurrency();
+
+        for(auto it = result.begin(); it != result.end(); ++it) {
+            if(*it >= limit) {
+                throw cocaine::error_t("CPU %d is out of range, only %d CPU(s) available", *it,
+                    limit);
+            }
+        }
+
+        return result;
+    }
+};
+
+template<>
+struct dynamic_converter<config_t::polling_t> {
+    typedef config_t::polling_t result_type;
+
+    static
+    result_type
+    convert(const dynamic_t& from) {
+        return config_t::polling_t {
+            from.as_object().at("pool", 0u).as_uint(),
+            from.as_object().at("spin", 100u).as_uint(),
+            from.as_object().at("busy-poll", 0u).as_uint()
+        };
+    }
+};
+
+template<>
+struct dynamic_converter<config_t::fairness_t> {
+    typedef config_t::fairness_t result_type;
+
+    static
+    result_type
+    convert(const dynamic_t& from) {
+        const auto frames = from.as_object().at("frames", 64u).as_uint();
+
+        if(frames == 0) {
+            throw cocaine::error_t("session frame limit must be positive");
+        }
+
+        return config_t::fairness_t {
+            frames,
+            from.as_object().at("budget", 0u).as_uint()
+        };
+    }
+};
+
+template<>
+struct dynamic_converter<config_t::memory_t> {
+    typedef config_t::memory_t result_type;
+
+    static
+    result_type
+    convert(const dynamic_t& from) {
+        return config_t::memory_t {
+            from.as_object().at("engine", 0u).as_uint(),
+            from.as_object().at("process", 0u).as_uint()
+        };
+    }
+};
+
 template<>
 struct dynamic_converter<config_t::logging_t> {
     typedef config_t::logging_t result_type;
@@ -311,6 +462,41 @@ config_t::config_t(const std::string& source) {
         throw cocaine::error_t("network I/O pool size must be positive");
     }
 
+    static const std::map<std::string, balancers> policies{
+        {"utilization",  balancers::utilization },
+        {"power-of-two", balancers::power_of_two}
+    };
+
+    const auto balancer = network_config.at("balancer", "utilization").as_string();
+
+    try {
+        network.balancer = policies.at(balancer);
+    } catch(const std::out_of_range&) {
+        throw cocaine::error_t("balancer \"%s\" not found", balancer);
+    }
+
+    static const std::map<std::string, backends> implementations{
+        {"reactor",  backends::reactor},
+        {"io_uring", backends::uring  }
+    };
+
+    const auto backend = network_config.at("backend", "reactor").as_string();
+
+    try {
+        network.backend = implementations.at(backend);
+    } catch(const std::out_of_range&) {
+        throw cocaine::error_t("I/O backend \"%s\" not found", backend);
+    }
+
+    network.rebalance = network_config.at("rebalance", 0).to<double>();
+
+    if(network.rebalance < 0) {
+        throw cocaine::error_t("network rebalance threshold must be non-negative");
+    }
+
+    network.affinity = network_config.at("affinity", dynamic_t::empty_object)
+        .to<config_t::affinity_t>();
+
     if(network_config.count("pinned")) {
         network.ports.pinned = network_config.at("pinned").to<decltype(network.ports.pinned)>();
     }
@@ -319,6 +505,40 @@ config_t::config_t(const std::string& source) {
         network.ports.shared = network_config.at("shared").to<decltype(network.ports.shared)>();
     }
 
+    if(network_config.count("transports")) {
+        network.transports = network_config.at("transports").to<config_t::transport_map_t>();
+    }
+
+    network.polling = network_config.at("polling", dynamic_t::empty_object)
+        .to<config_t::polling_t>();
+
+    const size_t engines = network.pool + network.polling.pool;
+
+    // NOTE: The units are pinned in a round-robin fashion, so with fewer CPUs the busy-polling ones
+    // would spin on the CPUs of the other units.
+    if(network.polling.pool && !network.affinity.engines.empty() &&
+       network.affinity.engines.size() < engines)
+    {
+        throw cocaine::error_t("engine affinity lists %d CPU(s), but busy-polling execution units "
+            "require one CPU per unit, i.e. %d", network.affinity.engines.size(), engines);
+    }
+
+    network.fairness = network_config.at("fairness", dynamic_t::empty_object)
+        .to<config_t::fairness_t>();
+
+    network.max_frame_size = network_config.at("max-frame-size", defaults::max_frame_size)
+        .as_uint();
+
+    network.memory = network_config.at("memory", dynamic_t::empty_object)
+        .to<config_t::memory_t>();
+
+    for(auto it = network.transports.begin(); it != network.transports.end(); ++it) {
+        if(it->second.polling && network.polling.pool == 0) {
+            throw cocaine::error_t("service \"%s\" requires busy-polling execution units",
+                it->first);
+        }
+    }
+
     // Blackhole logging configuration
     logging = root.as_object().at("logging",  dynamic_t::empty_object).to<config_t::logging_t>();
 
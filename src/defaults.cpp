@@ -26,6 +26,7 @@ const std::string defaults::plugins_path  = "/usr/lib/cocaine";
 const std::string defaults::runtime_path  = "/var/run/cocaine";
 
 const std::string defaults::endpoint      = "::";
+const size_t defaults::max_frame_size      = 256 << 20;
 
 const std::string defaults::log_verbosity = "info";
 const std::string defaults::log_timestamp = "%Y-%m-%d %H:%M:%S.%f";
\ No newline at end of file
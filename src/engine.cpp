@@ -25,30 +25,121 @@
 
 #include "cocaine/detail/chamber.hpp"
 
+#include "cocaine/rpc/asio/memory_budget.hpp"
 #include "cocaine/rpc/asio/transport.hpp"
 #include "cocaine/rpc/session.hpp"
 
+#include <blackhole/attribute.hpp>
 #include <blackhole/logger.hpp>
-#include <blackhole/wrapper.hpp>
 
 #include <asio/io_service.hpp>
 #include <asio/ip/tcp.hpp>
 #include <asio/local/stream_protocol.hpp>
 
+#include <boost/lexical_cast.hpp>
+
+#include <mutex>
+
 using namespace cocaine;
 using namespace cocaine::io;
 
 using namespace asio;
 
-class execution_unit_t::gc_action_t:
-    public std::enable_shared_from_this<gc_action_t>
+namespace {
+
+#if defined(SO_BUSY_POLL)
+typedef asio::detail::socket_option::integer<SOL_SOCKET, SO_BUSY_POLL> busy_poll;
+#endif
+
+// Session logger which formats its attributes only when something is actually logged, so that the
+// connections which never log anything don't pay for it.
+
+template<class Endpoint>
+class connection_logger_t:
+    public blackhole::logger_t
+{
+    blackhole::logger_t& inner;
+
+    const Endpoint endpoint;
+    const std::string service;
+
+    std::once_flag flag;
+
+    blackhole::attributes_t attributes;
+    blackhole::attribute_list view;
+
+public:
+    connection_logger_t(blackhole::logger_t& log, const Endpoint& endpoint_, std::string service_):
+        inner(log),
+        endpoint(endpoint_),
+        service(std::move(service_))
+    { }
+
+    auto log(blackhole::severity_t severity, const blackhole::message_t& message) -> void {
+        blackhole::attribute_pack pack{attach()};
+        inner.log(severity, message, pack);
+    }
+
+    auto log(blackhole::severity_t severity, const blackhole::message_t& message,
+             blackhole::attribute_pack& pack) -> void
+    {
+        pack.push_back(attach());
+        inner.log(severity, message, pack);
+    }
+
+    auto log(blackhole::severity_t severity, const blackhole::lazy_message_t& message,
+             blackhole::attribute_pack& pack) -> void
+    {
+        pack.push_back(attach());
+        inner.log(severity, message, pack);
+    }
+
+    auto manager() -> blackhole::scope::manager_t& {
+        return inner.manager();
+    }
+
+private:
+    auto
+    attach() -> const blackhole::attribute_list& {
+        std::call_once(flag, [this] {
+            attributes = {
+                {"endpoint", boost::lexical_cast<std::string>(endpoint)},
+                {"service",  service                                    }
+            };
+
+            for(auto it = attributes.begin(); it != attributes.end(); ++it) {
+                view.emplace_back(*it);
+            }
+        });
+
+        return view;
+    }
+};
+
+// Every execution unit is pinned to a single CPU from the configured set in a round-robin fashion.
+
+affinity_t
+placement(const config_t::affinity_t& affinity, size_t index) {
+    affinity_t result = { std::vector<unsigned int>(), affinity.numa };
+
+    if(!affinity.engines.empty()) {
+        result.cpus.push_back(affinity.engines[index % affinity.engines.size()]);
+    }
+
+    return result;
+}
+
+} // namespace
+
+class execution_unit_t::stats_action_t:
+    public std::enable_shared_from_this<stats_action_t>
 {
     execution_unit_t *const parent;
     const boost::posix_time::seconds repeat;
 
 public:
     template<class Interval>
-    gc_action_t(execution_unit_t *const parent_, Interval repeat_):
+    stats_action_t(execution_unit_t *const parent_, Interval repeat_):
         parent(parent_),
         repeat(repeat_)
     { }
@@ -62,52 +153,271 @@ private:
 };
 
 void
-execution_unit_t::gc_action_t::operator()() {
+execution_unit_t::stats_action_t::operator()() {
     if(!parent->m_cron) {
         return;
     }
 
     parent->m_cron->expires_from_now(repeat);
 
-    parent->m_cron->async_wait(std::bind(&gc_action_t::finalize,
+    parent->m_cron->async_wait(std::bind(&stats_action_t::finalize,
         shared_from_this(),
         std::placeholders::_1
     ));
 }
 
 void
-execution_unit_t::gc_action_t::finalize(const std::error_code& ec) {
+execution_unit_t::stats_action_t::finalize(const std::error_code& ec) {
     if(ec == asio::error::operation_aborted) {
         return;
     }
 
-    size_t recycled = 0;
+    COCAINE_LOG_DEBUG(parent->m_log, "sessions: {:d} active", parent->m_sessions.size());
+
+    COCAINE_LOG_DEBUG(parent->m_log, "read buffer pool: {:d} borrowed, {:d} idle buffer(s)",
+        parent->m_buffers->borrowed(), parent->m_buffers->idle());
+
+    COCAINE_LOG_DEBUG(parent->m_log, "overflows: {:d} paused, {:d} signalled, {:d} dropped",
+        parent->m_overflows->paused.load(),
+        parent->m_overflows->signalled.load(),
+        parent->m_overflows->disconnected.load());
+
+    COCAINE_LOG_DEBUG(parent->m_log, "outbound: {:d} message(s) in {:d} write(s)",
+        parent->m_outbound->messages.load(),
+        parent->m_outbound->writes.load());
+
+    COCAINE_LOG_DEBUG(parent->m_log, "migrations: {:d} session(s) in {:d}us total",
+        parent->m_migrations->migrated.load(),
+        parent->m_migrations->elapsed.load());
+
+    size_t deprioritized = 0;
+
+    for(auto it = parent->m_sessions.begin(); it != parent->m_sessions.end(); ++it) {
+        const auto& fairness = it->second->fairness();
 
-    for(auto it = parent->m_sessions.begin(); it != parent->m_sessions.end();) {
-        if(!it->second->memory_pressure()) {
-            recycled++;
-            it = parent->m_sessions.erase(it);
+        if(fairness.quota >= parent->m_config.network.fairness.frames) {
             continue;
         }
 
-        ++it;
+        deprioritized++;
+
+        COCAINE_LOG_DEBUG(parent->m_log, "session on fd {:d} is deprioritized to {:d} frame(s) per "
+            "turn: {:d} of {:d} turn(s) exhausted, {:d} frame(s) in {:d}us", it->first,
+            fairness.quota,
+            fairness.exhausted,
+            fairness.turns,
+            fairness.frames,
+            fairness.elapsed);
+    }
+
+    COCAINE_LOG_DEBUG(parent->m_log, "fairness: {:d} session(s) deprioritized", deprioritized);
+
+    io::channel_stats_t channels = { 0, 0, 0 };
+
+    for(auto it = parent->m_sessions.begin(); it != parent->m_sessions.end(); ++it) {
+        const auto stats = it->second->channel_stats();
+
+        channels.active    += stats.active;
+        channels.capacity  += stats.capacity;
+        channels.reclaimed += stats.reclaimed;
+    }
+
+    COCAINE_LOG_DEBUG(parent->m_log, "channels: {:d} active in {:d} slot(s), {:d} mute reclaimed",
+        channels.active,
+        channels.capacity,
+        channels.reclaimed);
+
+    COCAINE_LOG_DEBUG(parent->m_log, "memory: {:d} byte(s) in use, {:d} peak, {:d} session(s) "
+        "dropped", parent->m_memory->usage(),
+        parent->m_memory->peak(),
+        parent->m_shed);
+
+    if(const auto process = parent->m_context.memory()) {
+        COCAINE_LOG_DEBUG(parent->m_log, "process memory: {:d} byte(s) in use, {:d} peak",
+            process->usage(),
+            process->peak());
+    }
+
+    if(const auto uring = io::uring_t::find(*parent->m_asio)) {
+        COCAINE_LOG_DEBUG(parent->m_log, "io_uring: {:d} operation(s) in {:d} submission(s)",
+            uring->stats().operations,
+            uring->stats().submissions);
+    }
+
+    if(parent->m_polling) {
+        const auto& polling = parent->m_chamber->polling();
+
+        COCAINE_LOG_DEBUG(parent->m_log, "polling: {:d}us working, {:d}us spinning, {:d}us parked",
+            polling.working.load() / 1000,
+            polling.spinning.load() / 1000,
+            polling.parked.load() / 1000);
+    }
+
+    operator()();
+}
+
+class execution_unit_t::probe_action_t:
+    public std::enable_shared_from_this<probe_action_t>
+{
+    execution_unit_t *const parent;
+    const boost::posix_time::milliseconds repeat;
+
+public:
+    template<class Interval>
+    probe_action_t(execution_unit_t *const parent_, Interval repeat_):
+        parent(parent_),
+        repeat(repeat_)
+    { }
+
+    void
+    operator()();
+
+private:
+    void
+    finalize(const std::error_code& ec);
+};
+
+void
+execution_unit_t::probe_action_t::operator()() {
+    if(!parent->m_probe) {
+        return;
+    }
+
+    parent->m_probe->expires_from_now(repeat);
+
+    parent->m_probe->async_wait(std::bind(&probe_action_t::finalize,
+        shared_from_this(),
+        std::placeholders::_1
+    ));
+}
+
+void
+execution_unit_t::probe_action_t::finalize(const std::error_code& ec) {
+    if(ec == asio::error::operation_aborted || !parent->m_probe) {
+        return;
+    }
+
+    // The timer handler is delayed by exactly as much as everything else queued in the reactor.
+    const auto delay = asio::deadline_timer::traits_type::now() - parent->m_probe->expires_at();
+    const auto sample = static_cast<uint64_t>(std::max<int64_t>(0, delay.total_microseconds()));
+
+    // Smooth out the latency a bit, so that a single slow turn doesn't scare all the new clients.
+    parent->m_latency = (parent->m_latency * 7 + sample) / 8;
+
+    // NOTE: The streams keep their charges to the budget up to date as they go, so the backlog is
+    // known without scanning the sessions. The idle pooled buffers aren't held by any of them.
+    const size_t usage = parent->m_memory->usage();
+    const size_t idle = parent->m_buffers->idle() * io::buffer_pool_t::kBufferSize;
+
+    parent->m_backlog = usage > idle ? usage - idle : 0;
+
+    // A session dropped here might be the busiest one as well, so there's no migration this time.
+    if(parent->m_memory->exceeded()) {
+        parent->shed();
+    } else if(parent->m_config.network.rebalance > 0) {
+        if(const auto target = parent->balance()) {
+            parent->rebalance(target);
+        }
+    }
+
+    operator()();
+}
+
+class execution_unit_t::sweep_action_t:
+    public std::enable_shared_from_this<sweep_action_t>
+{
+    execution_unit_t *const parent;
+    const boost::posix_time::seconds repeat;
+
+public:
+    template<class Interval>
+    sweep_action_t(execution_unit_t *const parent_, Interval repeat_):
+        parent(parent_),
+        repeat(repeat_)
+    { }
+
+    void
+    operator()();
+
+private:
+    void
+    finalize(const std::error_code& ec);
+};
+
+void
+execution_unit_t::sweep_action_t::operator()() {
+    if(!parent->m_sweep) {
+        return;
+    }
+
+    parent->m_sweep->expires_from_now(repeat);
+
+    parent->m_sweep->async_wait(std::bind(&sweep_action_t::finalize,
+        shared_from_this(),
+        std::placeholders::_1
+    ));
+}
+
+void
+execution_unit_t::sweep_action_t::finalize(const std::error_code& ec) {
+    if(ec == asio::error::operation_aborted || !parent->m_sweep) {
+        return;
     }
 
-    if(recycled) {
-        COCAINE_LOG_DEBUG(parent->m_log, "recycled {:d} session(s)", recycled);
+    const auto now = std::chrono::steady_clock::now();
+
+    // NOTE: Sessions dropped here are removed from the table later, once their connections are
+    // destroyed, so the iteration is safe.
+    for(auto it = parent->m_sessions.begin(); it != parent->m_sessions.end(); ++it) {
+        it->second->sweep(now);
     }
 
     operator()();
 }
 
-execution_unit_t::execution_unit_t(context_t& context):
+execution_unit_t::execution_unit_t(context_t& context, size_t index, bool polling):
+    m_context(context),
+    m_config(context.config),
+    m_polling(polling),
+    m_memory(std::make_shared<io::memory_budget_t>(m_config.network.memory.engine,
+        context.memory())),
+    m_buffers(std::make_shared<io::buffer_pool_t>(io::buffer_pool_t::kDefaultCapacity, m_memory)),
+    m_overflows(std::make_shared<io::overflow_stats_t>()),
+    m_outbound(std::make_shared<io::outbound_stats_t>()),
+    m_active(0),
+    m_backlog(0),
+    m_latency(0),
+    m_shed(0),
+    m_migrations(std::make_shared<migration_stats_t>()),
     m_asio(new io_service()),
-    m_chamber(new chamber_t("core/asio", m_asio)),
+    m_chamber(new chamber_t(cocaine::format(polling ? "polling/%d" : "engine/%d", index), m_asio,
+        placement(context.config.network.affinity, index),
+        io::polling_t{polling, std::chrono::microseconds(context.config.network.polling.spin)})),
     m_log(context.log("core/asio", {{"engine", m_chamber->thread_id()}})),
-    m_cron(new asio::deadline_timer(*m_asio))
+    m_cron(new asio::deadline_timer(*m_asio)),
+    m_probe(new asio::deadline_timer(*m_asio)),
+    m_sweep(new asio::deadline_timer(*m_asio))
 {
-    m_asio->post(std::bind(&gc_action_t::operator(),
-        std::make_shared<gc_action_t>(this, boost::posix_time::seconds(kCollectionInterval))
+    if(m_config.network.backend == config_t::backends::uring) {
+        try {
+            // NOTE: Streams pick the rings up from the reactor the sockets are created on.
+            asio::add_service(*m_asio, new io::uring_t(*m_asio));
+        } catch(const std::system_error& e) {
+            COCAINE_LOG_WARNING(m_log, "unable to set up io_uring, falling back to the reactor: {}",
+                error::to_string(e));
+        }
+    }
+
+    m_asio->post(std::bind(&stats_action_t::operator(),
+        std::make_shared<stats_action_t>(this, boost::posix_time::seconds(kStatsInterval))
+    ));
+
+    m_asio->post(std::bind(&probe_action_t::operator(),
+        std::make_shared<probe_action_t>(this, boost::posix_time::milliseconds(kProbeInterval))
+    ));
+
+    m_asio->post(std::bind(&sweep_action_t::operator(),
+        std::make_shared<sweep_action_t>(this, boost::posix_time::seconds(kSweepInterval))
     ));
 
     COCAINE_LOG_DEBUG(m_log, "engine started");
@@ -122,9 +432,11 @@ execution_unit_t::~execution_unit_t() {
             it->second->detach(std::error_code());
         }
 
-        // NOTE: It's okay to destroy deadline timer here, because garbage collector always performs
-        // existence check for timer.
+        // NOTE: It's okay to destroy deadline timers here, because all the periodic actions always
+        // perform existence check for their timers.
         m_cron.reset();
+        m_probe.reset();
+        m_sweep.reset();
     });
 
     // NOTE: This will block until all the outstanding operations are complete.
@@ -138,24 +450,57 @@ execution_unit_t::attach(std::unique_ptr<Socket> ptr, const dispatch_ptr_t& disp
     typedef typename socket_type::protocol_type protocol_type;
     typedef session<protocol_type> session_type;
 
-    int fd;
-
-    if((fd = ::dup(ptr->native_handle())) == -1) {
-        throw std::system_error(errno, std::system_category(), "unable to clone client's socket");
-    }
-
     std::shared_ptr<session_type> session_;
 
     try {
-        // Local endpoint address of the socket to be cloned.
-        const auto endpoint = ptr->local_endpoint();
+        if(&ptr->get_io_service() != m_asio.get()) {
+            // NOTE: Sockets which weren't accepted directly onto this execution unit have to be
+            // cloned into its reactor. Acceptors should use asio() to avoid this.
+            ptr = clone(*ptr);
+        }
+
+        const int fd = ptr->native_handle();
+
+        // The endpoint to identify the connection by in the logs.
+        const auto endpoint = std::is_same<protocol_type, ip::tcp>::value ?
+            ptr->remote_endpoint() :
+            ptr->local_endpoint();
+
+        auto transport = std::make_unique<io::transport<protocol_type>>(std::move(ptr), m_buffers);
+
+        auto overflow = io::overflow_policies::pause;
+
+        std::chrono::seconds read_idle(0), write_idle(0), heartbeat(0);
+
+        size_t interleave = 0;
+
+        transport->reader->limit(m_config.network.max_frame_size);
+        transport->writer->stats(m_outbound);
 
-        // Copy the socket into the new reactor.
-        auto transport = std::make_unique<io::transport<protocol_type>>(
-            std::make_unique<socket_type>(*m_asio, endpoint.protocol(), fd)
-        );
+        if(dispatch && m_config.network.transports.count(dispatch->name())) {
+            const auto& options = m_config.network.transports.at(dispatch->name());
 
-        std::string remote_endpoint;
+            transport->writer->coalesce(options.coalesce);
+            transport->writer->limit(options.limit);
+            transport->reader->mirrored(options.mirrored);
+
+            if(options.max_frame_size) {
+                transport->reader->limit(options.max_frame_size);
+            }
+
+            read_idle = std::chrono::seconds(options.read_idle);
+            write_idle = std::chrono::seconds(options.write_idle);
+            heartbeat = std::chrono::seconds(options.heartbeat);
+
+            interleave = options.interleave;
+
+            if(std::is_same<protocol_type, local::stream_protocol>::value) {
+                // Only co-located clients can map the rings.
+                transport->reader->shared(options.shared);
+            }
+
+            overflow = options.overflow;
+        }
 
         if(std::is_same<protocol_type, ip::tcp>::value) {
             // Disable Nagle's algorithm, since most of the service clients do not send or receive
@@ -168,36 +513,251 @@ execution_unit_t::attach(std::unique_ptr<Socket> ptr, const dispatch_ptr_t& disp
             // NOTE: There is another solution: with reading `null_buffers` every N seconds we can
             // check an error code received.
             transport->socket->set_option(asio::socket_base::keep_alive(true));
-            remote_endpoint = boost::lexical_cast<std::string>(ptr->remote_endpoint());
-        } else if(std::is_same<protocol_type, local::stream_protocol>::value) {
-            remote_endpoint = boost::lexical_cast<std::string>(endpoint);
-        } else {
-            remote_endpoint = "<unknown>";
-        }
 
-        std::unique_ptr<logging::logger_t> log(new blackhole::wrapper_t(*m_log, {
-            {"endpoint", remote_endpoint                       },
-            {"service",  dispatch ? dispatch->name() : "<none>"}
-        }));
+#if defined(SO_BUSY_POLL)
+            if(m_polling && m_config.network.polling.busy_poll) {
+                std::error_code ec;
 
-        COCAINE_LOG_DEBUG(log, "attached connection to engine, load: {:.2f}%", utilization() * 100);
+                // NOTE: Raising it over the net.core.busy_read sysctl requires CAP_NET_ADMIN, and
+                // the connection works just fine without it anyway.
+                transport->socket->set_option(busy_poll(m_config.network.polling.busy_poll), ec);
+
+                if(ec) {
+                    COCAINE_LOG_DEBUG(m_log, "unable to enable busy polling on fd {:d}: {}", fd,
+                        ec.message());
+                }
+            }
+#endif
+        }
+
+        std::unique_ptr<logging::logger_t> log(new connection_logger_t<typename protocol_type::endpoint>(
+            *m_log,
+            endpoint,
+            dispatch ? dispatch->name() : "<none>"
+        ));
 
         // Create a new inactive session.
         session_ = std::make_shared<session_type>(std::move(log), std::move(transport), dispatch);
+        session_->overflow(overflow, m_overflows);
+        session_->fairness(m_config.network.fairness.frames,
+            std::chrono::microseconds(m_config.network.fairness.budget));
+        session_->timeouts(read_idle, write_idle, heartbeat);
+        session_->interleave(interleave);
+
+        // Accounted right away, so that the connections attached in a burst see each other.
+        const auto active = ++m_active;
+
+        COCAINE_LOG_DEBUG(m_log, "attached connection on fd {:d} to engine, {:d} session(s)", fd,
+            active);
+
+        m_asio->dispatch([=] {
+            insert(fd, session_);
+            session_->pull();
+        });
     } catch(const std::system_error& e) {
         throw std::system_error(e.code(), "client has disappeared while creating session");
     }
 
-    m_asio->dispatch([=]() mutable { (m_sessions[fd] = std::move(session_))->pull(); });
-
     return session_;
 }
 
+template<class Socket>
+std::unique_ptr<Socket>
+execution_unit_t::clone(Socket& socket) {
+    int fd;
+
+    if((fd = ::dup(socket.native_handle())) == -1) {
+        throw std::system_error(errno, std::system_category(), "unable to clone client's socket");
+    }
+
+    try {
+        return std::make_unique<Socket>(*m_asio, socket.local_endpoint().protocol(), fd);
+    } catch(...) {
+        ::close(fd);
+        throw;
+    }
+}
+
+void
+execution_unit_t::insert(int fd, const std::shared_ptr<session_t>& session) {
+    auto& slot = m_sessions[fd];
+
+    if(slot) {
+        // The session previously stored in this slot is detached, as its fd is reused.
+        --m_active;
+    }
+
+    slot = session;
+
+    const auto ptr = session.get();
+
+    // Sessions are forgotten as soon as their connections are destroyed.
+    session->detached([this, fd, ptr] { remove(fd, ptr); });
+}
+
+void
+execution_unit_t::remove(int fd, const session_t* session) {
+    const auto it = m_sessions.find(fd);
+
+    if(it == m_sessions.end() || it->second.get() != session) {
+        return;
+    }
+
+    m_sessions.erase(it);
+    --m_active;
+}
+
+void
+execution_unit_t::shed() {
+    auto heaviest = m_sessions.end();
+    size_t pressure = 0;
+
+    for(auto it = m_sessions.begin(); it != m_sessions.end(); ++it) {
+        const size_t bytes = it->second->memory_pressure();
+
+        if(bytes > pressure) {
+            heaviest = it;
+            pressure = bytes;
+        }
+    }
+
+    if(heaviest == m_sessions.end()) {
+        return;
+    }
+
+    COCAINE_LOG_WARNING(m_log, "memory budget exceeded with {:d} byte(s) in use, dropping session "
+        "on fd {:d} holding {:d} byte(s)", m_memory->usage(),
+        heaviest->first,
+        pressure);
+
+    m_shed++;
+
+    heaviest->second->detach(error::memory_budget_exceeded);
+}
+
+execution_unit_t*
+execution_unit_t::balance() {
+    const auto now = std::chrono::steady_clock::now();
+
+    if(now - m_migrated < std::chrono::seconds(kMigrationInterval)) {
+        return nullptr;
+    }
+
+    // Sessions never leave their pool, as services choose between the pools explicitly.
+    const auto& engines = m_context.engines(m_polling);
+
+    execution_unit_t* target = nullptr;
+
+    for(auto it = engines.begin(); it != engines.end(); ++it) {
+        if(it->get() != this && (!target || (*it)->load() < target->load())) {
+            target = it->get();
+        }
+    }
+
+    if(!target || load() - target->load() < m_config.network.rebalance) {
+        return nullptr;
+    }
+
+    m_migrated = now;
+
+    return target;
+}
+
+void
+execution_unit_t::rebalance(execution_unit_t* target) {
+    // The busiest session is the best candidate for migration. The activity counters are reset on
+    // every pass, so that the next one only sees the frames handled since this one.
+    auto busiest = m_sessions.end();
+    size_t activity = 0;
+
+    for(auto it = m_sessions.begin(); it != m_sessions.end(); ++it) {
+        const size_t frames = it->second->activity();
+
+        if(frames > activity) {
+            busiest = it;
+            activity = frames;
+        }
+
+        it->second->reset_activity();
+    }
+
+    if(busiest == m_sessions.end()) {
+        return;
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    const auto stats = m_migrations;
+
+    const auto fd = busiest->first;
+    const auto ptr = busiest->second.get();
+
+    busiest->second->migrate(target->asio(), target->m_buffers,
+        [this, fd, ptr] {
+            remove(fd, ptr);
+        },
+        [target, stats, now](const std::shared_ptr<session_t>& migrated, int descriptor) {
+            if(migrated->is_attached()) {
+                ++target->m_active;
+                target->insert(descriptor, migrated);
+            }
+
+            stats->migrated++;
+            stats->elapsed += std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - now
+            ).count();
+        }
+    );
+}
+
 double
 execution_unit_t::utilization() const {
     return m_chamber->load_avg1();
 }
 
+double
+execution_unit_t::load() const {
+    // Every session weighs the same as 64KB of buffered data or a millisecond of reactor latency,
+    // so that the units which are actually struggling are avoided even if they have few clients.
+    return m_active.load(std::memory_order_relaxed)
+         + m_backlog.load(std::memory_order_relaxed) / 65536.0
+         + m_latency.load(std::memory_order_relaxed) / 1000.0;
+}
+
+io_service&
+execution_unit_t::asio() const {
+    return *m_asio;
+}
+
+bool
+execution_unit_t::polling() const {
+    return m_polling;
+}
+
+const io::buffer_pool_t&
+execution_unit_t::buffers() const {
+    return *m_buffers;
+}
+
+const io::memory_budget_t&
+execution_unit_t::memory() const {
+    return *m_memory;
+}
+
+const io::overflow_stats_t&
+execution_unit_t::overflows() const {
+    return *m_overflows;
+}
+
+const io::outbound_stats_t&
+execution_unit_t::outbound() const {
+    return *m_outbound;
+}
+
+const execution_unit_t::migration_stats_t&
+execution_unit_t::migrations() const {
+    return *m_migrations;
+}
+
 template
 std::shared_ptr<session<ip::tcp>>
 execution_unit_t::attach(std::unique_ptr<ip::tcp::socket>, const dispatch_ptr_t&);
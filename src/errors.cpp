@@ -70,6 +70,12 @@ class transport_category_t:
             return "insufficient bytes provided to decode the message";
         if(code == cocaine::error::transport_errors::parse_error)
             return "unable to parse the incoming data";
+        if(code == cocaine::error::transport_errors::outbound_overflow)
+            return "outbound queue limit exceeded";
+        if(code == cocaine::error::transport_errors::frame_too_large)
+            return "message exceeds the frame size limit";
+        if(code == cocaine::error::transport_errors::memory_budget_exceeded)
+            return "memory budget exceeded";
 
         return "cocaine.rpc.transport error";
     }
@@ -0,0 +1,101 @@
+/*
+    Copyright (c) 2011-2014 Andrey Sibiryov <me@kobology.ru>
+    Copyright (c) 2011-2014 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "cocaine/rpc/asio/mirrored_buffer.hpp"
+
+#include <cerrno>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+    #include <sys/syscall.h>
+#endif
+
+using namespace cocaine::io;
+
+namespace {
+
+int
+create_backing_file() {
+#if defined(__linux__) && defined(SYS_memfd_create)
+    return ::syscall(SYS_memfd_create, "cocaine-ring", 1U /* MFD_CLOEXEC */);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+} // namespace
+
+mirrored_buffer_t::mirrored_buffer_t(size_t size) {
+    const size_t page = ::sysconf(_SC_PAGESIZE);
+
+    m_size = (size + page - 1) / page * page;
+
+    const int fd = create_backing_file();
+
+    if(fd == -1) {
+        throw std::system_error(errno, std::system_category(), "unable to create ring backing file");
+    }
+
+    if(::ftruncate(fd, m_size) != 0) {
+        const int ec = errno;
+        ::close(fd);
+        throw std::system_error(ec, std::system_category(), "unable to resize ring backing file");
+    }
+
+    // Reserve the address space for both halves first, so that they're guaranteed to be adjacent.
+    void* base = ::mmap(nullptr, m_size * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if(base == MAP_FAILED) {
+        const int ec = errno;
+        ::close(fd);
+        throw std::system_error(ec, std::system_category(), "unable to reserve ring address space");
+    }
+
+    m_data = static_cast<char*>(base);
+
+    for(size_t i = 0; i < 2; ++i) {
+        void* half = ::mmap(m_data + m_size * i, m_size, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_FIXED, fd, 0);
+
+        if(half == MAP_FAILED) {
+            const int ec = errno;
+            ::munmap(base, m_size * 2);
+            ::close(fd);
+            throw std::system_error(ec, std::system_category(), "unable to map ring");
+        }
+    }
+
+    // The mappings keep the backing file alive.
+    ::close(fd);
+}
+
+mirrored_buffer_t::~mirrored_buffer_t() {
+    ::munmap(m_data, m_size * 2);
+}
+
+void
+mirrored_buffer_t::discard() {
+#if defined(MADV_REMOVE)
+    ::madvise(m_data, m_size, MADV_REMOVE);
+#endif
+}
@@ -29,6 +29,110 @@ using namespace cocaine::service;
 
 namespace ph = std::placeholders;
 
+class storage_t::upload_slot_t:
+    public basic_slot<storage::upload>
+{
+    typedef protocol<event_traits<storage::upload>::dispatch_type>::scope stream;
+    typedef protocol<event_traits<storage::upload>::upstream_type>::scope result;
+
+    class upload_t:
+        public basic_slot<storage::upload>::dispatch_type
+    {
+        // NOTE: Both are reset once the upload is either complete or failed, so that the rest of
+        // the stream is ignored. Discarding the channel has to abandon the upload, hence mutable.
+        mutable std::unique_ptr<api::storage_t::writer_t> writer;
+        upstream_type upstream;
+
+    public:
+        upload_t(std::unique_ptr<api::storage_t::writer_t> writer_, upstream_type&& upstream_):
+            basic_slot<storage::upload>::dispatch_type("upload"),
+            writer(std::move(writer_)),
+            upstream(std::move(upstream_))
+        {
+            on<stream::chunk>([this](const std::string& chunk) {
+                if(!writer) return;
+
+                try {
+                    writer->write(chunk);
+                } catch(const std::exception& e) {
+                    fail(e);
+                }
+            });
+
+            on<stream::error>([this](const std::error_code&, const std::string&) {
+                writer = nullptr;
+            });
+
+            on<stream::choke>([this] {
+                if(!writer) return;
+
+                try {
+                    writer->commit();
+                } catch(const std::exception& e) {
+                    return fail(e);
+                }
+
+                writer = nullptr;
+                upstream.send<result::value>();
+            });
+        }
+
+        virtual
+        void
+        discard(const std::error_code&) const {
+            writer = nullptr;
+        }
+
+        // NOTE: The backends throw more than std::system_error, e.g. the filesystem errors, so
+        // the rest are reported as uncaught errors with their descriptions.
+        static
+        void
+        fail(upstream_type& upstream, const std::exception& e) {
+            const auto ptr = dynamic_cast<const std::system_error*>(&e);
+
+            upstream.send<result::error>(ptr ? ptr->code() :
+                std::error_code(cocaine::error::uncaught_error), std::string(e.what()));
+        }
+
+    private:
+        void
+        fail(const std::exception& e) {
+            writer = nullptr;
+            fail(upstream, e);
+        }
+    };
+
+    const std::shared_ptr<api::storage_t> storage;
+
+public:
+    upload_slot_t(const std::shared_ptr<api::storage_t>& storage_):
+        storage(storage_)
+    { }
+
+    auto
+    operator()(tuple_type&& args, upstream_type&& upstream)
+        -> boost::optional<std::shared_ptr<const dispatch_type>>
+    {
+        std::unique_ptr<api::storage_t::writer_t> writer;
+
+        try {
+            writer = cocaine::tuple::invoke(std::move(args),
+                [this](std::string&& collection, std::string&& key, std::vector<std::string>&& tags)
+            {
+                return storage->open(collection, key, tags);
+            });
+        } catch(const std::exception& e) {
+            // Without a writer, the upload ignores the rest of the stream.
+            upload_t::fail(upstream, e);
+        }
+
+        const std::shared_ptr<const dispatch_type> dispatch =
+            std::make_shared<upload_t>(std::move(writer), std::move(upstream));
+
+        return boost::make_optional(dispatch);
+    }
+};
+
 storage_t::storage_t(context_t& context, asio::io_service& asio, const std::string& name, const dynamic_t& args):
     category_type(context, asio, name, args),
     dispatch<storage_tag>(name)
@@ -39,6 +143,7 @@ storage_t::storage_t(context_t& context, asio::io_service& asio, const std::stri
     on<storage::write>(std::bind(&api::storage_t::write, storage, ph::_1, ph::_2, ph::_3, ph::_4));
     on<storage::remove>(std::bind(&api::storage_t::remove, storage, ph::_1, ph::_2));
     on<storage::find>(std::bind(&api::storage_t::find, storage, ph::_1, ph::_2));
+    on<storage::upload>(std::make_shared<upload_slot_t>(storage));
 }
 
 const basic_dispatch_t&
@@ -22,6 +22,11 @@
 
 #include "cocaine/logging.hpp"
 
+#include "cocaine/detail/block_pool.hpp"
+
+#include "cocaine/idl/control.hpp"
+
+#include "cocaine/rpc/asio/memory_budget.hpp"
 #include "cocaine/rpc/asio/transport.hpp"
 
 #include "cocaine/rpc/dispatch.hpp"
@@ -37,6 +42,17 @@ using namespace cocaine::io;
 
 using namespace asio;
 
+namespace {
+
+// Whether nothing can ever be received with the dispatch, e.g. it has been reached by a mute slot.
+// The remote peer never revokes channels in such a state, so they have to be reclaimed locally.
+bool
+is_mute(const dispatch_ptr_t& dispatch) {
+    return dispatch && dispatch->root().empty();
+}
+
+} // namespace
+
 // Session internals
 
 class session_t::pull_action_t:
@@ -53,7 +69,7 @@ public:
     { }
 
     void
-    operator()(const std::shared_ptr<transport_type> ptr);
+    operator()();
 
 private:
     void
@@ -61,7 +77,17 @@ private:
 };
 
 void
-session_t::pull_action_t::operator()(const std::shared_ptr<transport_type> ptr) {
+session_t::pull_action_t::operator()() {
+    const auto ptr = session->attached.load();
+
+    if(!ptr) {
+        return;
+    }
+
+    if(!session->is_owner()) {
+        session->adopt();
+    }
+
     ptr->reader->read(message, std::bind(&pull_action_t::finalize,
         shared_from_this(),
         std::placeholders::_1
@@ -80,11 +106,19 @@ session_t::pull_action_t::finalize(const std::error_code& ec) {
         return session->detach(ec);
     }
 
-#if defined(__clang__)
-    if(const auto ptr = std::atomic_load(&session->transport)) {
-#else
-    if(const auto ptr = *session->transport.synchronize()) {
-#endif
+    // NOTE: Already buffered frames are handled in one go only up to the session's limits, so that
+    // pipelining clients don't starve other sessions on the same execution unit.
+    const auto started = std::chrono::steady_clock::now();
+    const auto quota = session->fairness_stats.quota;
+
+    for(size_t batch = 0; batch < quota; ++batch) {
+        const auto ptr = session->attached.load();
+
+        if(!ptr) {
+            COCAINE_LOG_DEBUG(session->log, "ignoring invocation due to detached session");
+            return;
+        }
+
         try {
             // NOTE: In case the underlying slot has miserably failed to handle its exceptions, the
             // client will be disconnected to prevent any further damage to the service and himself.
@@ -98,17 +132,40 @@ session_t::pull_action_t::finalize(const std::error_code& ec) {
             return session->detach(error::uncaught_error);
         }
 
+        std::error_code decode_ec;
+
+        const bool exhausted = batch + 1 == quota || session->overran(started);
+
+        // Handle the frames that are already buffered right away, without a reactor round trip.
+        if(!session->paused && !exhausted && ptr->reader->read_buffered(message, decode_ec)) {
+            if(decode_ec) {
+                return finalize(decode_ec);
+            }
+
+            continue;
+        }
+
+        if(session->paused) {
+            // The client doesn't read its responses, so stop reading its requests until it does.
+            // The session will start pulling again once the outbound queue is drained.
+            session->pulling = false;
+            return;
+        }
+
+        if(session->migration && session->depart(ptr)) {
+            // The session will continue pulling on its new execution unit.
+            return;
+        }
+
+        session->yielded(batch + 1, started, exhausted && ptr->reader->pending());
+
         // Cycle the transport back into the message pump.
-        operator()(std::move(ptr));
-    } else {
-        COCAINE_LOG_DEBUG(session->log, "ignoring invocation due to detached session");
+        return operator()();
     }
 }
 
-class session_t::push_action_t:
-    public enable_shared_from_this<push_action_t>
-{
-    const encoder_t::message_type message;
+class session_t::push_action_t {
+    encoder_t::message_type message;
 
     // Keeps the session alive until all the operations are complete.
     const std::shared_ptr<session_t> session;
@@ -120,113 +177,122 @@ public:
     { }
 
     void
-    operator()(const std::shared_ptr<transport_type> ptr);
-
-private:
-    void
-    finalize(const std::error_code& ec);
-};
-
-void
-session_t::push_action_t::operator()(const std::shared_ptr<transport_type> ptr) {
-    if(!trace_t::current().empty()) {
-        if(trace_t::current().pushed()) {
-            COCAINE_LOG_INFO(session->log, "cs");
-        } else {
-            COCAINE_LOG_INFO(session->log, "ss");
-        }
+    operator()() {
+        session->write(std::move(message));
     }
-
-    ptr->writer->write(message, trace_t::bind(&push_action_t::finalize,
-        shared_from_this(),
-        std::placeholders::_1
-    ));
-}
-
-void
-session_t::push_action_t::finalize(const std::error_code& ec) {
-    COCAINE_LOG_ZIPKIN(session->log, "after send");
-    if(ec.value() == 0) return;
-
-    if(ec != asio::error::eof) {
-        COCAINE_LOG_ERROR(session->log, "client disconnected: [{:d}] {}", ec.value(), ec.message());
-    } else {
-        COCAINE_LOG_DEBUG(session->log, "client disconnected");
-    }
-
-    return session->detach(ec);
-}
-
-class session_t::channel_t
-{
-public:
-    channel_t(const dispatch_ptr_t& dispatch_, const upstream_ptr_t& upstream_):
-        dispatch(dispatch_),
-        upstream(upstream_)
-    { }
-
-    dispatch_ptr_t dispatch;
-    upstream_ptr_t upstream;
 };
 
 // Session
 
 session_t::session_t(std::unique_ptr<logging::logger_t> log_, std::unique_ptr<transport_type> transport_, const dispatch_ptr_t& prototype_):
     log(std::move(log_)),
-    transport(std::shared_ptr<transport_type>(std::move(transport_))),
+    transport(std::move(transport_)),
+    attached(transport.get()),
+    reactor(&transport->socket->get_io_service()),
+    owner(std::thread::id()),
     prototype(prototype_),
-    max_channel_id(0)
-{ }
+    active(0),
+    reclaimed(0),
+    upstreams(std::make_shared<block_pool_t>()),
+    memory(std::make_shared<memory_budget_t>(0, transport->reader->pool()->budget())),
+    max_channel_id(0),
+    overflow_policy(io::overflow_policies::pause),
+    overflow_stats(std::make_shared<io::overflow_stats_t>()),
+    paused(false),
+    pulling(false),
+    congestion(false),
+    frames(0),
+    frame_limit(kFrameLimit),
+    time_limit(0),
+    strikes(0),
+    interleaving(0)
+{
+    fairness_stats.quota = frame_limit;
+
+    liveness.read_timeout = liveness.write_timeout = liveness.heartbeat = std::chrono::seconds(0);
+    liveness.received = liveness.transmitted = 0;
+    liveness.read = liveness.sent = liveness.flushed = std::chrono::steady_clock::now();
+
+    transport->budget(memory);
+
+    try {
+        peer = transport->socket->remote_endpoint();
+    } catch(const std::system_error& e) {
+        // Ignore.
+    }
+}
 
 // Operations
 
 void
 session_t::handle(const decoder_t::message_type& message) {
-    const channel_map_t::key_type channel_id = message.span();
+    const uint64_t channel_id = message.span();
     boost::optional<trace_t> incoming_trace;
 
-    const auto channel = channels.apply([&](channel_map_t& mapping) -> std::shared_ptr<channel_t> {
-        channel_map_t::const_iterator lb, ub;
+    frames++;
+
+    if(channel_id == 0) {
+        // Control messages, e.g. heartbeats, only keep the connection alive.
+        if(message.type() != event_traits<control::interleave>::id || !interleaving) {
+            return;
+        }
+
+        if(const auto ptr = attached.load()) {
+            COCAINE_LOG_DEBUG(log, "interleaving outbound messages in {:d} byte fragments",
+                interleaving);
+
+            ptr->writer->interleave(interleaving);
+        }
+
+        return;
+    }
+
+    auto channel = channels.find(channel_id);
 
-        std::tie(lb, ub) = mapping.equal_range(channel_id);
+    if(!channel) {
+        uint64_t expected = max_channel_id;
 
-        if(lb == ub) {
-            if(channel_id <= max_channel_id) {
+        do {
+            if(channel_id <= expected) {
                 // NOTE: Checking whether channel number is always higher than the previous channel
                 // number is similar to an infinite TIME_WAIT timeout for TCP sockets. It might be
                 // not the best approach, but since we have 2^64 possible channels it's good enough.
                 throw std::system_error(error::revoked_channel, std::to_string(channel_id));
             }
+        } while(!max_channel_id.compare_exchange_weak(expected, channel_id));
 
-            std::tie(lb, std::ignore) = mapping.insert({channel_id, std::make_shared<channel_t>(
-                prototype,
-                // Do not store trace if we handling server side.
-                std::make_shared<basic_upstream_t>(shared_from_this(), channel_id, boost::none)
-            )});
+        channel = &channels.insert(channel_id, channel_t{
+            prototype,
+            // Do not store trace if we handling server side.
+            std::allocate_shared<basic_upstream_t>(pooled<basic_upstream_t>(upstreams),
+                shared_from_this(), channel_id, boost::none)
+        });
 
-            max_channel_id = channel_id;
-        }
-        if(lb->second->upstream->client_trace) {
-            incoming_trace = lb->second->upstream->client_trace;
-        } else {
-            auto trace_header = message.meta<hpack::headers::trace_id<>>();
-            auto span_header = message.meta<hpack::headers::span_id<>>();
-            auto parent_header = message.meta<hpack::headers::parent_id<>>();
-            if(trace_header && span_header && parent_header) {
-                incoming_trace = trace_t(
-                    trace_header->get_value().convert<uint64_t>(),
-                    span_header->get_value().convert<uint64_t>(),
-                    parent_header->get_value().convert<uint64_t>(),
-                    std::get<0>(lb->second->dispatch->root().at(message.type()))
-                );
-            }
-        }
+        active.store(channels.size(), std::memory_order_relaxed);
+    }
 
-        // NOTE: The virtual channel pointer is copied here to avoid data races.
-        return lb->second;
-    });
+    // NOTE: The channel state is copied here, because the channel table might be modified while the
+    // message is being processed, e.g. by forking new channels.
+    const auto dispatch = channel->dispatch;
+    const auto upstream = channel->upstream;
+
+    if(upstream->client_trace) {
+        incoming_trace = upstream->client_trace;
+    } else if(dispatch) {
+        auto trace_header = message.meta<hpack::headers::trace_id<>>();
+        auto span_header = message.meta<hpack::headers::span_id<>>();
+        auto parent_header = message.meta<hpack::headers::parent_id<>>();
+        if(trace_header && span_header && parent_header) {
+            incoming_trace = trace_t(
+                trace_header->get_value().convert<uint64_t>(),
+                span_header->get_value().convert<uint64_t>(),
+                parent_header->get_value().convert<uint64_t>(),
+                std::get<0>(dispatch->root().at(message.type()))
+            );
+        }
+    }
 
-    if(!channel->dispatch) {
+    if(!dispatch) {
         throw std::system_error(error::unbound_dispatch);
     }
 
@@ -234,11 +300,11 @@ session_t::handle(const decoder_t::message_type& message) {
 
     COCAINE_LOG_DEBUG(log, "invocation type {}: '{}' in channel {}, dispatch: '{}'",
         message.type(),
-        channel->dispatch->root().count(message.type()) ?
-            std::get<0>(channel->dispatch->root().at(message.type()))
+        dispatch->root().count(message.type()) ?
+            std::get<0>(dispatch->root().at(message.type()))
           : "<undefined>",
         channel_id,
-        channel->dispatch->name());
+        dispatch->name());
 
     if(!trace_t::current().empty()) {
         if(trace_t::current().pushed()) {
@@ -249,150 +315,551 @@ session_t::handle(const decoder_t::message_type& message) {
         }
     }
 
-    if((channel->dispatch = channel->dispatch->process(message, channel->upstream)
-        .get_value_or(channel->dispatch)) == nullptr)
-    {
+    const auto next = dispatch->process(message, upstream).get_value_or(dispatch);
+
+    // NOTE: The channel is no longer in the table if it was discarded during session::detach(),
+    // which was called during the dispatch::process().
+    if((channel = channels.find(channel_id)) == nullptr) {
+        return;
+    }
+
+    if(is_mute(next)) {
+        // NOTE: The client can't send anything else on this channel, so it's torn down right away.
+        // The dispatch isn't discarded, since it's a normal completion.
+        channel->dispatch = nullptr;
+        reclaimed++;
+        revoke(channel_id);
+    } else if((channel->dispatch = next) == nullptr) {
         // NOTE: If the client has sent us the last message according to our dispatch graph, revoke
-        // the channel. No-op if the channel is no longer in the mapping, e.g., was discarded during
-        // session::detach(), which was called during the dispatch::process().
-        if(!channel.unique()) revoke(channel_id);
+        // the channel.
+        revoke(channel_id);
     }
 }
 
 void
 session_t::revoke(uint64_t channel_id) {
-    channels.apply([&](channel_map_t& mapping) {
-        auto it = mapping.find(channel_id);
+    const auto channel = channels.find(channel_id);
 
-        if(it == mapping.end()) {
-            COCAINE_LOG_WARNING(log, "ignoring revoke request for channel {:d}", channel_id);
-            return;
-        }
+    if(!channel) {
+        COCAINE_LOG_WARNING(log, "ignoring revoke request for channel {:d}", channel_id);
+        return;
+    }
 
-        if(it->second->dispatch) {
-            COCAINE_LOG_ERROR(log, "revoking channel {:d}, dispatch: '{}'", channel_id,
-                it->second->dispatch->name());
-            it->second->dispatch->discard(std::error_code());
-        } else {
-            COCAINE_LOG_DEBUG(log, "revoking channel {:d}", channel_id);
-        }
+    const auto dispatch = std::move(channel->dispatch);
 
-        mapping.erase(it);
-    });
+    channels.erase(channel_id);
+    active.store(channels.size(), std::memory_order_relaxed);
+
+    if(dispatch) {
+        COCAINE_LOG_ERROR(log, "revoking channel {:d}, dispatch: '{}'", channel_id,
+            dispatch->name());
+        dispatch->discard(std::error_code());
+    } else {
+        COCAINE_LOG_DEBUG(log, "revoking channel {:d}", channel_id);
+    }
 }
 
 upstream_ptr_t
 session_t::fork(const dispatch_ptr_t& dispatch) {
-    return channels.apply([&](channel_map_t& mapping) -> upstream_ptr_t {
-        const auto channel_id = ++max_channel_id;
-        auto trace = trace_t::current();
-        trace.push(dispatch->name());
-        const auto downstream = std::make_shared<basic_upstream_t>(shared_from_this(), channel_id, trace);
-
-        COCAINE_LOG_DEBUG(log, "forking new channel {:d}, dispatch: '{}'", channel_id,
-            dispatch ? dispatch->name() : "<none>");
-
-        if(dispatch) {
-            // NOTE: For mute slots, creating a new channel will essentially leak memory, since no
-            // response will ever be sent back, therefore the channel will never be revoked at all.
-            mapping.insert({channel_id, std::make_shared<channel_t>(dispatch, downstream)});
-        }
+    const uint64_t channel_id = ++max_channel_id;
+
+    auto trace = trace_t::current();
+    trace.push(dispatch->name());
+
+    const auto downstream = std::allocate_shared<basic_upstream_t>(
+        pooled<basic_upstream_t>(upstreams),
+        shared_from_this(),
+        channel_id,
+        trace
+    );
+
+    COCAINE_LOG_DEBUG(log, "forking new channel {:d}, dispatch: '{}'", channel_id,
+        dispatch ? dispatch->name() : "<none>");
+
+    if(!dispatch || !attached) {
+        return downstream;
+    }
 
+    if(is_mute(dispatch)) {
+        // NOTE: No response will ever be sent back on this channel, so registering it would leak it
+        // until the session is detached.
+        reclaimed++;
         return downstream;
+    }
+
+    if(is_owner()) {
+        channels.insert(channel_id, channel_t{dispatch, downstream});
+        active.store(channels.size(), std::memory_order_relaxed);
+    } else {
+        const auto self = shared_from_this();
+
+        // The channel is registered before any message can be sent to it, as the handlers are
+        // delivered in order.
+        post([self, channel_id, dispatch, downstream] {
+            if(self->attached) {
+                self->channels.insert(channel_id, channel_t{dispatch, downstream});
+                self->active.store(self->channels.size(), std::memory_order_relaxed);
+            }
+        });
+    }
+
+    return downstream;
+}
+
+void
+session_t::overload(transport_type* ptr) {
+    switch(overflow_policy) {
+    case io::overflow_policies::pause:
+        if(paused) {
+            return;
+        }
+
+        paused = true;
+        overflow_stats->paused++;
+
+        COCAINE_LOG_DEBUG(log, "pausing session with {:d} outbound byte(s) pending",
+            ptr->writer->pressure());
+        break;
+
+    case io::overflow_policies::signal:
+        if(congestion.exchange(true)) {
+            return;
+        }
+
+        overflow_stats->signalled++;
+
+        COCAINE_LOG_DEBUG(log, "signalling congestion with {:d} outbound byte(s) pending",
+            ptr->writer->pressure());
+        break;
+
+    case io::overflow_policies::disconnect:
+        overflow_stats->disconnected++;
+
+        COCAINE_LOG_WARNING(log, "dropping slow client with {:d} outbound byte(s) pending",
+            ptr->writer->pressure());
+        return detach(error::outbound_overflow);
+    }
+
+    const std::weak_ptr<session_t> weak = shared_from_this();
+
+    ptr->writer->drained([weak] {
+        if(const auto session = weak.lock()) session->drained();
     });
 }
 
+void
+session_t::drained() {
+    congestion = false;
+
+    if(!paused) {
+        return;
+    }
+
+    paused = false;
+
+    if(pulling) {
+        // The pull action hasn't noticed the pause yet, so there's nothing to resume.
+        return;
+    }
+
+    COCAINE_LOG_DEBUG(log, "resuming session");
+
+    try {
+        pull();
+    } catch(const std::system_error& e) {
+        // The session has been detached in the meantime.
+    }
+}
+
 // Channel I/O
 
 void
 session_t::pull() {
-#if defined(__clang__)
-    if(const auto ptr = std::atomic_load(&transport)) {
-#else
-    if(const auto ptr = *transport.synchronize()) {
-#endif
-        // Use dispatch() instead of a direct call for thread safety.
-        ptr->socket->get_io_service().dispatch(std::bind(&pull_action_t::operator(),
-            std::make_shared<pull_action_t>(shared_from_this()),
-            ptr
-        ));
-    } else {
+    if(!attached) {
         throw std::system_error(error::not_connected);
     }
+
+    pulling = true;
+
+    // Use dispatch() instead of a direct call for thread safety.
+    reactor.load()->dispatch(std::bind(&pull_action_t::operator(),
+        std::make_shared<pull_action_t>(shared_from_this())
+    ));
 }
 
 void
 session_t::push(encoder_t::message_type&& message) {
-#if defined(__clang__)
-    if(const auto ptr = std::atomic_load(&transport)) {
-#else
-    if(const auto ptr = *transport.synchronize()) {
-#endif
-        // Use dispatch() instead of a direct call for thread safety.
-        ptr->socket->get_io_service().dispatch(trace_t::bind(&push_action_t::operator(),
-            std::make_shared<push_action_t>(std::move(message), shared_from_this()),
-            ptr
-        ));
-    } else {
+    if(!attached) {
         throw std::system_error(error::not_connected);
     }
+
+    if(is_owner()) {
+        // Fast path: the connection can be used right away, as it can't be destroyed concurrently.
+        return write(std::move(message));
+    }
+
+    // Hand the message over to the execution unit thread.
+    post(trace_t::bind(&push_action_t::operator(),
+        std::make_shared<push_action_t>(std::move(message), shared_from_this())
+    ));
 }
 
 void
-session_t::detach(const std::error_code& ec) {
-#if defined(__clang__)
-    if(auto swapped = std::atomic_exchange(&transport, std::shared_ptr<transport_type>())) {
-#else
-    if(auto swapped = std::move(*transport.synchronize())) {
-#endif
-        swapped = nullptr;
-        COCAINE_LOG_DEBUG(log, "detached session from the transport");
-    } else {
-        COCAINE_LOG_WARNING(log, "ignoring detach request for session");
+session_t::write(encoder_t::message_type&& message) {
+    const auto ptr = attached.load();
+
+    if(!ptr) {
+        // The session has been detached after this message was handed over to the reactor.
         return;
     }
 
-    channels.apply([&](channel_map_t& mapping) {
-        if(mapping.empty()) {
-            return;
+    writer_type::handler_type handle;
+
+    if(!trace_t::current().empty()) {
+        if(trace_t::current().pushed()) {
+            COCAINE_LOG_INFO(log, "cs");
         } else {
-            COCAINE_LOG_DEBUG(log, "discarding {:d} channel dispatch(es)", mapping.size());
+            COCAINE_LOG_INFO(log, "ss");
         }
 
-        for(auto it = mapping.begin(); it != mapping.end(); ++it) {
-            if(it->second->dispatch) it->second->dispatch->discard(ec);
+        // Only traced messages need to know when they're actually sent.
+        handle = trace_t::bind(&session_t::sent, shared_from_this(), std::placeholders::_1);
+    }
+
+    ptr->writer->write(std::move(message), std::move(handle));
+
+    if(ptr->writer->overloaded()) {
+        overload(ptr);
+    }
+}
+
+void
+session_t::sent(const std::error_code& ec) {
+    if(!ec) {
+        COCAINE_LOG_ZIPKIN(log, "after send");
+    }
+}
+
+void
+session_t::failed(const std::error_code& ec) {
+    if(ec != asio::error::eof) {
+        COCAINE_LOG_ERROR(log, "client disconnected: [{:d}] {}", ec.value(), ec.message());
+    } else {
+        COCAINE_LOG_DEBUG(log, "client disconnected");
+    }
+
+    detach(ec);
+}
+
+void
+session_t::detach(const std::error_code& ec) {
+    if(!attached.exchange(nullptr)) {
+        COCAINE_LOG_WARNING(log, "ignoring detach request for session");
+        return;
+    }
+
+    // NOTE: Only the thread which has cleared the raw pointer might touch the owning one. The
+    // connection itself is destroyed on the execution unit thread once the current handler there
+    // completes, because it might still be using the raw pointer.
+    auto ptr = std::move(transport);
+    auto self = shared_from_this();
+
+    std::function<void()> handler = [ptr, self]() mutable {
+        // Destroying the connection aborts all its outstanding operations, so the buffers will be
+        // released as soon as their completion handlers are done.
+        ptr = nullptr;
+
+        if(self->reclaim) {
+            self->reclaim();
         }
+    };
+
+    // The handler must hold the only reference, so that it's never destroyed on this thread.
+    ptr = nullptr;
+
+    post(std::move(handler));
+
+    COCAINE_LOG_DEBUG(log, "detached session from the transport");
+
+    if(is_owner()) {
+        discard(ec);
+    } else {
+        post(std::bind(&session_t::discard, shared_from_this(), ec));
+    }
+}
+
+void
+session_t::discard(const std::error_code& ec) {
+    channel_map_t mapping;
+
+    // NOTE: The dispatches might fork new channels while being discarded, so the table is detached
+    // before the iteration.
+    std::swap(mapping, channels);
+    active.store(0, std::memory_order_relaxed);
 
-        mapping.clear();
+    if(mapping.empty()) {
+        return;
+    } else {
+        COCAINE_LOG_DEBUG(log, "discarding {:d} channel dispatch(es)", mapping.size());
+    }
+
+    mapping.visit([&](uint64_t, const channel_t& channel) {
+        if(channel.dispatch) channel.dispatch->discard(ec);
     });
 }
 
+void
+session_t::overflow(io::overflow_policies policy,
+                    const std::shared_ptr<io::overflow_stats_t>& stats)
+{
+    overflow_policy = policy;
+    overflow_stats = stats;
+}
+
+void
+session_t::fairness(size_t quota, std::chrono::microseconds budget) {
+    BOOST_ASSERT(quota > 0);
+
+    frame_limit = fairness_stats.quota = quota;
+    time_limit = budget;
+}
+
+bool
+session_t::migrate(asio::io_service& target, const std::shared_ptr<io::buffer_pool_t>& pool,
+                   departed_handler_type departed, arrived_handler_type arrived)
+{
+    BOOST_ASSERT(is_owner());
+
+    if(std::chrono::steady_clock::now() - arrival < std::chrono::seconds(kMigrationCooldown)) {
+        return false;
+    }
+
+    migration.reset(new migration_t{&target, pool, std::move(departed), std::move(arrived)});
+
+    return true;
+}
+
+bool
+session_t::depart(transport_type* ptr) {
+    if(ptr->reader->pending() || !ptr->writer->idle()) {
+        // Some frame is partially received or some messages are being written, try next time.
+        return false;
+    }
+
+    const auto request = std::move(migration);
+
+    try {
+        ptr->migrate(*request->target, request->pool);
+    } catch(const std::system_error& e) {
+        COCAINE_LOG_WARNING(log, "unable to migrate session: {}", error::to_string(e));
+        return false;
+    }
+
+    // The streams are charged to the new execution unit's budget now, switch them back.
+    memory->reparent(ptr->reader->pool()->budget());
+    ptr->budget(memory);
+
+    COCAINE_LOG_DEBUG(log, "migrating session to another execution unit");
+
+    const auto self = shared_from_this();
+    const auto fd = ptr->socket->native_handle();
+    const auto arrived = std::move(request->arrived);
+
+    request->departed();
+    reclaim = nullptr;
+
+    // NOTE: From now on this thread must not touch the session, everything else, including the
+    // pending deliveries, will follow the session to its new execution unit. The upstream pool is
+    // disowned as well, so that the upstreams freed here in the meantime go to its shared list.
+    owner.store(std::thread::id(), std::memory_order_relaxed);
+    upstreams->owner(std::thread::id());
+    reactor.store(request->target);
+
+    request->target->post([self, fd, arrived] {
+        self->arrival = std::chrono::steady_clock::now();
+
+        arrived(self, fd);
+
+        try {
+            self->pull();
+        } catch(const std::system_error& e) {
+            // The session has been detached in the meantime.
+        }
+    });
+
+    return true;
+}
+
+void
+session_t::timeouts(std::chrono::seconds read, std::chrono::seconds write,
+                    std::chrono::seconds heartbeat)
+{
+    liveness.read_timeout = read;
+    liveness.write_timeout = write;
+    liveness.heartbeat = heartbeat;
+}
+
+void
+session_t::interleave(size_t fragment) {
+    interleaving = fragment;
+}
+
+void
+session_t::sweep(std::chrono::steady_clock::time_point now) {
+    const auto ptr = attached.load();
+
+    if(!ptr) {
+        return;
+    }
+
+    const auto received = ptr->reader->received();
+    const auto transmitted = ptr->writer->transmitted();
+
+    if(received != liveness.received) {
+        liveness.received = received;
+        liveness.read = now;
+    } else if(paused) {
+        // NOTE: The client isn't silent, it's the session that has stopped reading because of the
+        // outbound queue overflow, so the clock restarts once the reading is resumed.
+        liveness.read = now;
+    }
+
+    if(transmitted != liveness.transmitted) {
+        liveness.transmitted = transmitted;
+        liveness.sent = liveness.flushed = now;
+    } else if(ptr->writer->idle()) {
+        liveness.flushed = now;
+    }
+
+    if(liveness.read_timeout.count() && now - liveness.read >= liveness.read_timeout) {
+        COCAINE_LOG_WARNING(log, "client has been silent for {:d}s, dropping",
+            liveness.read_timeout.count());
+        return detach(asio::error::timed_out);
+    }
+
+    if(liveness.write_timeout.count() && now - liveness.flushed >= liveness.write_timeout) {
+        COCAINE_LOG_WARNING(log, "client hasn't read anything for {:d}s, dropping",
+            liveness.write_timeout.count());
+        return detach(asio::error::timed_out);
+    }
+
+    if(liveness.heartbeat.count() && now - liveness.sent >= liveness.heartbeat &&
+       ptr->writer->idle())
+    {
+        write(encoded<control::heartbeat>(0));
+
+        // Accounted right away, so that the heartbeats don't pile up if the write is slow.
+        liveness.sent = now;
+    }
+}
+
+bool
+session_t::overran(std::chrono::steady_clock::time_point started) const {
+    return time_limit.count() && std::chrono::steady_clock::now() - started >= time_limit;
+}
+
+void
+session_t::yielded(size_t handled, std::chrono::steady_clock::time_point started, bool exhausted) {
+    fairness_stats.turns++;
+    fairness_stats.frames += handled;
+    fairness_stats.elapsed += std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - started).count();
+
+    if(!exhausted) {
+        // Restore the quota gradually, so that a flood with short pauses stays deprioritized.
+        strikes = 0;
+        fairness_stats.quota = std::min(fairness_stats.quota * 2, frame_limit);
+        return;
+    }
+
+    fairness_stats.exhausted++;
+
+    if(++strikes < kStrikeLimit) {
+        return;
+    }
+
+    if(fairness_stats.quota > 1) {
+        COCAINE_LOG_DEBUG(log, "deprioritizing session, frame quota lowered to {:d}",
+            fairness_stats.quota / 2);
+    }
+
+    strikes = 0;
+    fairness_stats.quota = std::max<size_t>(fairness_stats.quota / 2, 1);
+}
+
+void
+session_t::detached(std::function<void()> handle) {
+    reclaim = std::move(handle);
+}
+
 // Information
 
 std::map<uint64_t, std::string>
 session_t::active_channels() const {
-    return channels.apply([](const channel_map_t& mapping) -> std::map<uint64_t, std::string> {
-        std::map<uint64_t, std::string> result;
-
-        for(auto it = mapping.begin(); it != mapping.end(); ++it) {
-            result[it->first] = it->second->dispatch ? it->second->dispatch->name() : "<none>";
+    std::map<uint64_t, std::string> result;
+
+    if(!is_owner()) {
+        if(attached) {
+            const auto self = std::const_pointer_cast<session_t>(shared_from_this());
+
+            // NOTE: Waiting for the snapshot here might deadlock the execution units querying each
+            // other's sessions, or hang if the execution unit has already stopped.
+            post([self] {
+                auto names = self->active_channels();
+                self->snapshot->swap(names);
+            });
         }
 
-        return result;
+        return *snapshot.synchronize();
+    }
+
+    channels.visit([&](uint64_t channel_id, const channel_t& channel) {
+        result[channel_id] = channel.dispatch ? channel.dispatch->name() : "<none>";
     });
+
+    return result;
+}
+
+size_t
+session_t::channel_count() const {
+    return active.load(std::memory_order_relaxed);
 }
 
 std::size_t
 session_t::memory_pressure() const {
-#if defined(__clang__)
-    if(const auto ptr = std::atomic_load(&transport)) {
-#else
-    if(const auto ptr = *transport.synchronize()) {
-#endif
-        return ptr->reader->pressure() + ptr->writer->pressure();
-    } else {
-        return 0;
-    }
+    return memory->usage();
+}
+
+size_t
+session_t::activity() const {
+    return frames;
+}
+
+void
+session_t::reset_activity() {
+    frames = 0;
+}
+
+bool
+session_t::congested() const {
+    return congestion;
+}
+
+const io::fairness_stats_t&
+session_t::fairness() const {
+    return fairness_stats;
+}
+
+io::channel_stats_t
+session_t::channel_stats() const {
+    io::channel_stats_t result = { channels.size(), channels.capacity(), reclaimed.load() };
+
+    return result;
+}
+
+bool
+session_t::is_attached() const {
+    return attached.load() != nullptr;
 }
 
 std::string
@@ -402,21 +869,71 @@ session_t::name() const {
 
 session_t::endpoint_type
 session_t::remote_endpoint() const {
-    endpoint_type endpoint;
+    return is_attached() ? peer : endpoint_type();
+}
 
-#if defined(__clang__)
-    if(const auto ptr = std::atomic_load(&transport)) {
-#else
-    if(const auto ptr = *transport.synchronize()) {
-#endif
-        try {
-            endpoint = ptr->socket->remote_endpoint();
-        } catch(const std::system_error& e) {
-            // Ignore.
-        }
+bool
+session_t::is_owner() const {
+    return owner.load(std::memory_order_relaxed) == std::this_thread::get_id();
+}
+
+void
+session_t::adopt() {
+    owner.store(std::this_thread::get_id(), std::memory_order_relaxed);
+    upstreams->owner(std::this_thread::get_id());
+
+    if(const auto ptr = attached.load()) {
+        const std::weak_ptr<session_t> weak = shared_from_this();
+
+        // Write errors are reported once per connection instead of once per message.
+        ptr->writer->failed([weak](const std::error_code& ec) {
+            if(const auto session = weak.lock()) session->failed(ec);
+        });
     }
+}
 
-    return endpoint;
+void
+session_t::post(std::function<void()> handler) {
+    bool idle = false;
+
+    mailbox.apply([&](std::deque<std::function<void()>>& queue) {
+        idle = queue.empty();
+        queue.push_back(std::move(handler));
+    });
+
+    if(!idle) {
+        // The delivery is already scheduled.
+        return;
+    }
+
+    const auto target = reactor.load();
+
+    target->post(std::bind(&session_t::deliver, shared_from_this(), target));
+}
+
+void
+session_t::deliver(asio::io_service* target) {
+    const auto current = reactor.load();
+
+    if(current != target) {
+        // The session has migrated while the delivery was pending, so follow it.
+        return current->post(std::bind(&session_t::deliver, shared_from_this(), current));
+    }
+
+    if(owner.load(std::memory_order_relaxed) == std::thread::id()) {
+        // The session has just arrived to this execution unit and hasn't started pulling yet.
+        adopt();
+    }
+
+    std::deque<std::function<void()>> handlers;
+
+    mailbox.apply([&](std::deque<std::function<void()>>& queue) {
+        std::swap(handlers, queue);
+    });
+
+    for(auto it = handlers.begin(); it != handlers.end(); ++it) {
+        (*it)();
+    }
 }
 
 namespace cocaine {
@@ -0,0 +1,573 @@
+/*
+    Copyright (c) 2011-2014 Andrey Sibiryov <me@kobology.ru>
+    Copyright (c) 2011-2014 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "cocaine/rpc/asio/shared_channel.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <new>
+
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+    #include <sys/eventfd.h>
+    #include <sys/syscall.h>
+#endif
+
+using namespace cocaine::io;
+
+namespace {
+
+// Ring headers and data are kept apart on their own cache lines.
+const size_t kAlignment = 64;
+
+auto
+align(size_t size, size_t alignment) -> size_t {
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+auto
+block_size(size_t capacity) -> size_t {
+    return align(sizeof(shared_channel_t::header_t), kAlignment) + capacity;
+}
+
+auto
+mapping_size(size_t capacity) -> size_t {
+    return align(block_size(capacity) * 2, ::sysconf(_SC_PAGESIZE));
+}
+
+void
+close_all(std::initializer_list<int> fds) {
+    for(auto it = fds.begin(); it != fds.end(); ++it) {
+        if(*it != -1) {
+            ::close(*it);
+        }
+    }
+}
+
+auto
+create_eventfd() -> int {
+#if defined(__linux__)
+    return ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+auto
+create_memfd() -> int {
+#if defined(__linux__) && defined(SYS_memfd_create)
+    return ::syscall(SYS_memfd_create, "cocaine-channel", 1U /* MFD_CLOEXEC */);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+// Waits for the socket to become ready, the socket might be in non-blocking mode.
+void
+wait(int socket, short events) {
+    pollfd pfd = { socket, events, 0 };
+
+    while(::poll(&pfd, 1, -1) == -1) {
+        if(errno != EINTR) {
+            throw std::system_error(errno, std::system_category(), "unable to wait for the peer");
+        }
+    }
+}
+
+} // namespace
+
+shared_channel_t::shared_channel_t(asio::io_service& asio, int socket, void* memory,
+                                   size_t capacity, bool server, int wakeup, int notify)
+:
+    m_memory(memory),
+    m_size(mapping_size(capacity)),
+    m_capacity(capacity),
+    m_notify(notify),
+    m_armed(false),
+    m_watched(false),
+    m_closed(false),
+    m_broken(false)
+{
+    ring_t rings[2];
+
+    for(size_t i = 0; i < 2; ++i) {
+        char* block = static_cast<char*>(m_memory) + block_size(capacity) * i;
+
+        rings[i].header = reinterpret_cast<header_t*>(block);
+        rings[i].data = block + align(sizeof(header_t), kAlignment);
+    }
+
+    m_rx = rings[server ? 0 : 1];
+    m_tx = rings[server ? 1 : 0];
+
+    // Both are zero in the freshly created memory, unless the peer has already tampered with it.
+    m_consumed = m_rx.header->head.load(std::memory_order_relaxed);
+    m_produced = m_tx.header->tail.load(std::memory_order_relaxed);
+
+    const int control = ::dup(socket);
+
+    if(control == -1) {
+        throw std::system_error(errno, std::system_category(), "unable to clone socket");
+    }
+
+    // NOTE: The descriptors are owned by the channel from now on, even if the constructor throws.
+    try {
+        m_wakeup = std::make_unique<asio::posix::stream_descriptor>(asio, wakeup);
+    } catch(...) {
+        close_all({wakeup, control, m_notify});
+        ::munmap(m_memory, m_size);
+        throw;
+    }
+
+    try {
+        m_control = std::make_unique<asio::posix::stream_descriptor>(asio, control);
+    } catch(...) {
+        close_all({control, m_notify});
+        ::munmap(m_memory, m_size);
+        throw;
+    }
+}
+
+shared_channel_t::~shared_channel_t() {
+    ::close(m_notify);
+    ::munmap(m_memory, m_size);
+}
+
+auto
+shared_channel_t::offer(asio::io_service& asio, int socket, size_t capacity)
+    -> std::shared_ptr<shared_channel_t>
+{
+    capacity = align(capacity, kAlignment);
+
+    int memory = -1, wakeup = -1, notify = -1;
+
+    if((memory = create_memfd()) == -1 ||
+       (wakeup = create_eventfd()) == -1 ||
+       (notify = create_eventfd()) == -1)
+    {
+        const int ec = errno;
+        close_all({memory, wakeup, notify});
+        throw std::system_error(ec, std::system_category(), "unable to create channel");
+    }
+
+    const size_t size = mapping_size(capacity);
+    void* ptr = MAP_FAILED;
+
+    if(::ftruncate(memory, size) == 0) {
+        ptr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, memory, 0);
+    }
+
+    if(ptr == MAP_FAILED) {
+        const int ec = errno;
+        close_all({memory, wakeup, notify});
+        throw std::system_error(ec, std::system_category(), "unable to map channel memory");
+    }
+
+    // Freshly truncated memory is zeroed, which is a valid empty ring state, but the atomics still
+    // have to be constructed properly.
+    for(size_t i = 0; i < 2; ++i) {
+        new(static_cast<char*>(ptr) + block_size(capacity) * i) header_t();
+    }
+
+    uint64_t announced = capacity;
+
+    iovec iov = { &announced, sizeof(announced) };
+
+    // Client's eventfd first, see the negotiation notes.
+    const int fds[] = { memory, notify, wakeup };
+
+    char control[CMSG_SPACE(sizeof(fds))];
+    std::memset(control, 0, sizeof(control));
+
+    msghdr message;
+    std::memset(&message, 0, sizeof(message));
+
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    cmsghdr* header = CMSG_FIRSTHDR(&message);
+
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(fds));
+
+    std::memcpy(CMSG_DATA(header), fds, sizeof(fds));
+
+    ssize_t sent;
+
+    // NOTE: The socket buffer is empty at this point, so it blocks for no more than a moment.
+    while((sent = ::sendmsg(socket, &message, MSG_NOSIGNAL)) == -1) {
+        if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            const int ec = errno;
+            close_all({memory, wakeup, notify});
+            ::munmap(ptr, size);
+            throw std::system_error(ec, std::system_category(), "unable to offer channel");
+        }
+
+        wait(socket, POLLOUT);
+    }
+
+    // The client has its own mapping now.
+    ::close(memory);
+
+    return std::make_shared<shared_channel_t>(asio, socket, ptr, capacity, true, wakeup, notify);
+}
+
+auto
+shared_channel_t::request(asio::io_service& asio, int socket) -> std::shared_ptr<shared_channel_t> {
+    const unsigned char magic = kMagic;
+
+    while(::send(socket, &magic, sizeof(magic), MSG_NOSIGNAL) != sizeof(magic)) {
+        if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            throw std::system_error(errno, std::system_category(), "unable to request channel");
+        }
+
+        wait(socket, POLLOUT);
+    }
+
+    uint64_t capacity = 0;
+
+    iovec iov = { &capacity, sizeof(capacity) };
+
+    int fds[3];
+
+    char control[CMSG_SPACE(sizeof(fds))];
+    std::memset(control, 0, sizeof(control));
+
+    msghdr message;
+    std::memset(&message, 0, sizeof(message));
+
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    ssize_t received;
+
+    while((received = ::recvmsg(socket, &message, MSG_CMSG_CLOEXEC)) == -1) {
+        if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            throw std::system_error(errno, std::system_category(), "unable to receive channel");
+        }
+
+        wait(socket, POLLIN);
+    }
+
+    cmsghdr* header = CMSG_FIRSTHDR(&message);
+
+    if(received != sizeof(capacity) || !header || header->cmsg_type != SCM_RIGHTS ||
+       header->cmsg_len != CMSG_LEN(sizeof(fds)))
+    {
+        if(header && header->cmsg_type == SCM_RIGHTS) {
+            const size_t count = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+
+            for(size_t i = 0; i < count; ++i) {
+                ::close(reinterpret_cast<int*>(CMSG_DATA(header))[i]);
+            }
+        }
+
+        throw std::system_error(EPROTO, std::system_category(), "unable to receive channel");
+    }
+
+    std::memcpy(fds, CMSG_DATA(header), sizeof(fds));
+
+    const size_t size = mapping_size(capacity);
+
+    void* ptr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0);
+
+    ::close(fds[0]);
+
+    if(ptr == MAP_FAILED) {
+        const int ec = errno;
+        close_all({fds[1], fds[2]});
+        throw std::system_error(ec, std::system_category(), "unable to map channel memory");
+    }
+
+    return std::make_shared<shared_channel_t>(asio, socket, ptr, capacity, false, fds[1], fds[2]);
+}
+
+void
+shared_channel_t::async_wait_readable(handler_type handle) {
+    BOOST_ASSERT(!m_readable);
+
+    m_readable = std::move(handle);
+
+    watch();
+    arm();
+}
+
+void
+shared_channel_t::async_wait_writable(handler_type handle) {
+    BOOST_ASSERT(!m_writable);
+
+    m_writable = std::move(handle);
+
+    watch();
+    arm();
+}
+
+void
+shared_channel_t::rebind(asio::io_service& target) {
+    if(&m_wakeup->get_io_service() == &target) {
+        return;
+    }
+
+    BOOST_ASSERT(!m_readable && !m_writable);
+
+    std::unique_ptr<asio::posix::stream_descriptor> descriptors[] = {
+        std::move(m_wakeup),
+        std::move(m_control)
+    };
+
+    std::unique_ptr<asio::posix::stream_descriptor>* targets[] = { &m_wakeup, &m_control };
+
+    for(size_t i = 0; i < 2; ++i) {
+        const int fd = ::dup(descriptors[i]->native_handle());
+
+        if(fd == -1) {
+            throw std::system_error(errno, std::system_category(), "unable to clone channel");
+        }
+
+        try {
+            *targets[i] = std::make_unique<asio::posix::stream_descriptor>(target, fd);
+        } catch(...) {
+            ::close(fd);
+            throw;
+        }
+    }
+
+    // NOTE: Closing the old descriptors aborts both the wakeup and the hangup watches, which are
+    // re-armed on the next wait.
+    m_armed = false;
+    m_watched = false;
+}
+
+auto
+shared_channel_t::read(char* data, size_t size) -> size_t {
+    if(m_broken) {
+        return 0;
+    }
+
+    header_t& header = *m_rx.header;
+
+    const uint64_t head = m_consumed;
+    const uint64_t tail = header.tail.load(std::memory_order_acquire);
+
+    // NOTE: The peer's index is loaded only once, so that it can't be changed after the check.
+    if(tail - head > m_capacity) {
+        m_broken = true;
+        return 0;
+    }
+
+    size = std::min<size_t>(size, tail - head);
+
+    const size_t offset = head % m_capacity;
+    const size_t first = std::min(size, m_capacity - offset);
+
+    std::memcpy(data, m_rx.data + offset, first);
+    std::memcpy(data + first, m_rx.data, size - first);
+
+    m_consumed = head + size;
+
+    header.head.store(m_consumed, std::memory_order_release);
+
+    return size;
+}
+
+auto
+shared_channel_t::write(const char* data, size_t size) -> size_t {
+    if(m_broken) {
+        return 0;
+    }
+
+    header_t& header = *m_tx.header;
+
+    const uint64_t head = header.head.load(std::memory_order_acquire);
+    const uint64_t tail = m_produced;
+
+    // NOTE: Catches the head moved past the tail as well, as the difference wraps around then.
+    if(tail - head > m_capacity) {
+        m_broken = true;
+        return 0;
+    }
+
+    size = std::min<size_t>(size, m_capacity - (tail - head));
+
+    const size_t offset = tail % m_capacity;
+    const size_t first = std::min(size, m_capacity - offset);
+
+    std::memcpy(m_tx.data + offset, data, first);
+    std::memcpy(m_tx.data, data + first, size - first);
+
+    m_produced = tail + size;
+
+    header.tail.store(m_produced, std::memory_order_release);
+
+    return size;
+}
+
+auto
+shared_channel_t::complete(size_t bytes, bool consumed, std::error_code& ec) -> size_t {
+    if(bytes == 0) {
+        if(m_broken) {
+            ec = std::error_code(EPROTO, std::system_category());
+        } else if(!m_closed) {
+            ec = asio::error::would_block;
+        } else if(consumed) {
+            ec = asio::error::eof;
+        } else {
+            ec = asio::error::broken_pipe;
+        }
+
+        return 0;
+    }
+
+    ec.clear();
+
+    // NOTE: Pairs with the fence in arm(), so that either the peer sees the published bytes after
+    // raising its flag, or this side sees the flag raised.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    auto& flag = consumed ? m_rx.header->starving : m_tx.header->sleeping;
+
+    if(flag.load(std::memory_order_relaxed) && flag.exchange(0)) {
+        const uint64_t value = 1;
+
+        // NOTE: This might fail only if the counter overflows, which means the peer has plenty of
+        // wakeups pending already.
+        if(::write(m_notify, &value, sizeof(value)) == -1) {
+            // Ignore.
+        }
+    }
+
+    return bytes;
+}
+
+// NOTE: Corrupted headers make the channel both readable and writable, so that the waiters find out
+// about it from the next operation.
+
+bool
+shared_channel_t::readable() const {
+    return m_closed || m_broken || m_rx.header->tail.load(std::memory_order_acquire) != m_consumed;
+}
+
+bool
+shared_channel_t::writable() const {
+    return m_closed || m_broken ||
+           m_produced - m_tx.header->head.load(std::memory_order_acquire) != m_capacity;
+}
+
+void
+shared_channel_t::arm() {
+    if(m_readable && !readable()) {
+        m_rx.header->sleeping.store(1);
+    }
+
+    if(m_writable && !writable()) {
+        m_tx.header->starving.store(1);
+    }
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    auto& asio = m_wakeup->get_io_service();
+
+    // Complete everything which is ready already, either before the flags were raised or right
+    // after that.
+    if(m_readable && readable()) {
+        asio.post(std::bind(std::move(m_readable), std::error_code()));
+        m_readable = nullptr;
+    }
+
+    if(m_writable && writable()) {
+        asio.post(std::bind(std::move(m_writable), std::error_code()));
+        m_writable = nullptr;
+    }
+
+    if((m_readable || m_writable) && !m_armed) {
+        m_armed = true;
+
+        // NOTE: Pending waits don't keep the channel alive, so that it can be destroyed along with
+        // its stream while the peer is idle.
+        std::weak_ptr<shared_channel_t> weak(shared_from_this());
+
+        m_wakeup->async_read_some(asio::null_buffers(), [weak](const std::error_code& ec, size_t) {
+            if(auto self = weak.lock()) {
+                self->wakeup(ec);
+            }
+        });
+    }
+}
+
+void
+shared_channel_t::wakeup(const std::error_code& ec) {
+    if(ec == asio::error::operation_aborted) {
+        return;
+    }
+
+    m_armed = false;
+
+    uint64_t value;
+
+    // Reset the counter, so that the next wakeup makes the descriptor readable again.
+    if(::read(m_wakeup->native_handle(), &value, sizeof(value)) == -1) {
+        // Ignore.
+    }
+
+    arm();
+}
+
+void
+shared_channel_t::watch() {
+    if(m_watched || m_closed) {
+        return;
+    }
+
+    m_watched = true;
+
+    std::weak_ptr<shared_channel_t> weak(shared_from_this());
+
+    // NOTE: Nothing is sent over the socket once the channel is set up, so it becomes readable only
+    // when either side shuts the connection down.
+    m_control->async_read_some(asio::null_buffers(), [weak](const std::error_code& ec, size_t) {
+        if(auto self = weak.lock()) {
+            self->hangup(ec);
+        }
+    });
+}
+
+void
+shared_channel_t::hangup(const std::error_code& ec) {
+    if(ec == asio::error::operation_aborted) {
+        return;
+    }
+
+    m_closed = true;
+
+    // Let the waiters find out that the peer is gone.
+    arm();
+}
@@ -22,6 +22,7 @@
 
 #include "cocaine/context.hpp"
 #include "cocaine/logging.hpp"
+#include "cocaine/unique_id.hpp"
 
 #include <numeric>
 
@@ -84,22 +85,7 @@ files_t::write(const std::string& collection, const std::string& key, const std:
 {
     std::lock_guard<std::mutex> guard(m_mutex);
 
-    const fs::path store_path(m_parent_path / collection);
-    const auto store_status = fs::status(store_path);
-
-    if(!fs::exists(store_status)) {
-        COCAINE_LOG_INFO(m_log, "creating collection", {
-            {"collection", collection}
-            // {"path", store_path}
-        });
-
-        fs::create_directories(store_path);
-    } else if(!fs::is_directory(store_status)) {
-        throw std::system_error(std::make_error_code(std::errc::not_a_directory),
-            store_path.string()
-        );
-    }
-
+    const fs::path store_path(prepare(collection));
     const fs::path file_path(store_path / key);
 
     COCAINE_LOG_DEBUG(m_log, "writing object '{}'", key, attribute_list({
@@ -115,24 +101,7 @@ files_t::write(const std::string& collection, const std::string& key, const std:
         );
     }
 
-    for(auto it = tags.begin(); it != tags.end(); ++it) {
-        const auto tag_path = store_path / *it;
-        const auto tag_status = fs::status(tag_path);
-
-        if(!fs::exists(tag_status)) {
-            fs::create_directory(tag_path);
-        } else if(!fs::is_directory(tag_status)) {
-            throw std::system_error(std::make_error_code(std::errc::not_a_directory),
-                tag_path.string()
-            );
-        }
-
-        if(fs::is_symlink(tag_path / key)) {
-            continue;
-        }
-
-        fs::create_symlink(file_path, tag_path / key);
-    }
+    link(store_path, key, tags);
 
     stream.write(blob.c_str(), blob.size());
     stream.close();
@@ -231,3 +200,137 @@ files_t::find(const std::string& collection, const std::vector<std::string>& tag
 
     return std::accumulate(result.begin(), result.end(), initial, intersect());
 }
+
+class files_t::upload_t:
+    public api::storage_t::writer_t
+{
+    files_t *const parent;
+
+    const std::string key;
+    const std::vector<std::string> tags;
+
+    fs::path store_path;
+    fs::path temp_path;
+    fs::ofstream stream;
+
+    bool committed;
+
+public:
+    upload_t(files_t *const parent_, const std::string& collection, const std::string& key_,
+             const std::vector<std::string>& tags_)
+    :
+        parent(parent_),
+        key(key_),
+        tags(tags_),
+        committed(false)
+    {
+        std::lock_guard<std::mutex> guard(parent->m_mutex);
+
+        store_path = parent->prepare(collection);
+
+        // Hidden from the readers until committed.
+        temp_path = store_path / ("." + key + "." + unique_id_t().string());
+
+        stream.open(temp_path, fs::ofstream::out | fs::ofstream::trunc | fs::ofstream::binary);
+
+        if(!stream) {
+            throw std::system_error(std::make_error_code(std::errc::permission_denied),
+                temp_path.string()
+            );
+        }
+    }
+
+   ~upload_t() {
+        if(committed) {
+            return;
+        }
+
+        stream.close();
+
+        boost::system::error_code ec;
+        fs::remove(temp_path, ec);
+    }
+
+    virtual
+    void
+    write(const std::string& chunk) {
+        if(!stream.write(chunk.data(), chunk.size())) {
+            throw std::system_error(std::make_error_code(std::errc::io_error), temp_path.string());
+        }
+    }
+
+    virtual
+    void
+    commit() {
+        stream.close();
+
+        if(!stream) {
+            throw std::system_error(std::make_error_code(std::errc::io_error), temp_path.string());
+        }
+
+        std::lock_guard<std::mutex> guard(parent->m_mutex);
+
+        fs::rename(temp_path, store_path / key);
+        committed = true;
+
+        parent->link(store_path, key, tags);
+    }
+};
+
+std::unique_ptr<api::storage_t::writer_t>
+files_t::open(const std::string& collection, const std::string& key,
+              const std::vector<std::string>& tags)
+{
+    COCAINE_LOG_DEBUG(m_log, "uploading object '{}'", key, attribute_list({
+        {"collection", collection}
+    }));
+
+    return std::make_unique<upload_t>(this, collection, key, tags);
+}
+
+fs::path
+files_t::prepare(const std::string& collection) {
+    const fs::path store_path(m_parent_path / collection);
+    const auto store_status = fs::status(store_path);
+
+    if(!fs::exists(store_status)) {
+        COCAINE_LOG_INFO(m_log, "creating collection", {
+            {"collection", collection}
+            // {"path", store_path}
+        });
+
+        fs::create_directories(store_path);
+    } else if(!fs::is_directory(store_status)) {
+        throw std::system_error(std::make_error_code(std::errc::not_a_directory),
+            store_path.string()
+        );
+    }
+
+    return store_path;
+}
+
+void
+files_t::link(const fs::path& store_path, const std::string& key,
+              const std::vector<std::string>& tags)
+{
+    const fs::path file_path(store_path / key);
+
+    for(auto it = tags.begin(); it != tags.end(); ++it) {
+        const auto tag_path = store_path / *it;
+        const auto tag_status = fs::status(tag_path);
+
+        if(!fs::exists(tag_status)) {
+            fs::create_directory(tag_path);
+        } else if(!fs::is_directory(tag_status)) {
+            throw std::system_error(std::make_error_code(std::errc::not_a_directory),
+                tag_path.string()
+            );
+        }
+
+        if(fs::is_symlink(tag_path / key)) {
+            continue;
+        }
+
+        fs::create_symlink(file_path, tag_path / key);
+    }
+}
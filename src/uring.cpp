@@ -0,0 +1,666 @@
+/*
+    Copyright (c) 2011-2014 Andrey Sibiryov <me@kobology.ru>
+    Copyright (c) 2011-2014 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "cocaine/rpc/asio/uring.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iterator>
+
+#include <poll.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if defined(__linux__) && defined(__has_include)
+    #if __has_include(<linux/io_uring.h>)
+        #include <linux/io_uring.h>
+        #include <sys/syscall.h>
+
+        #if defined(__NR_io_uring_setup) && defined(IORING_FEAT_NODROP)
+            #define COCAINE_HAS_FEATURE_URING
+        #endif
+    #endif
+#endif
+
+using namespace cocaine::io;
+
+asio::io_service::id uring_t::id;
+
+#if defined(COCAINE_HAS_FEATURE_URING)
+
+namespace {
+
+template<class T>
+T*
+offset(void* base, size_t bytes) {
+    return reinterpret_cast<T*>(static_cast<char*>(base) + bytes);
+}
+
+void
+prepare(io_uring_sqe* sqe, unsigned opcode, int fd, const void* data, size_t size, unsigned flags,
+        uint64_t user_data)
+{
+    std::memset(sqe, 0, sizeof(*sqe));
+
+    sqe->opcode    = opcode;
+    sqe->fd        = fd;
+    sqe->addr      = reinterpret_cast<uint64_t>(data);
+    sqe->len       = size;
+    sqe->user_data = user_data;
+
+    if(opcode == IORING_OP_POLL_ADD) {
+        sqe->poll_events = flags;
+    } else {
+        sqe->msg_flags = flags;
+    }
+}
+
+} // namespace
+
+// Shared ring mappings.
+
+struct uring_t::ring_t {
+    COCAINE_DECLARE_NONCOPYABLE(ring_t)
+
+    // Submission queue size, the completion queue is kCompletionRatio times larger, since there's
+    // an operation in flight for every connection, and the submission queue is drained every turn.
+    static const unsigned kEntries = 1024;
+    static const unsigned kCompletionRatio = 32;
+
+    int fd;
+
+    void*  sq_ptr;
+    size_t sq_size;
+    void*  cq_ptr;
+    size_t cq_size;
+
+    io_uring_sqe* sqes;
+    size_t sqes_size;
+
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_array;
+    unsigned  sq_mask;
+    unsigned  sq_entries;
+
+    // Local copy of the submission queue tail, the kernel never touches it.
+    unsigned tail;
+
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned  cq_mask;
+    io_uring_cqe* cqes;
+
+    ring_t();
+   ~ring_t();
+
+    // Returns the next free submission entry, or nullptr if the queue is full.
+    auto
+    next() -> io_uring_sqe*;
+
+    // Makes the entries returned by next() visible to the kernel.
+    void
+    publish();
+
+private:
+    void
+    probe();
+
+    void
+    release();
+};
+
+uring_t::ring_t::ring_t():
+    fd(-1),
+    sq_ptr(MAP_FAILED),
+    cq_ptr(MAP_FAILED),
+    sqes(static_cast<io_uring_sqe*>(MAP_FAILED)),
+    tail(0)
+{
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = kEntries * kCompletionRatio;
+
+    if((fd = ::syscall(__NR_io_uring_setup, kEntries, &params)) == -1) {
+        throw std::system_error(errno, std::system_category(), "unable to set up io_uring");
+    }
+
+    try {
+        // NOTE: Without it the completions of the operations over the completion queue size are
+        // dropped, and there are as many operations in flight as there are connections.
+        if(!(params.features & IORING_FEAT_NODROP)) {
+            throw std::system_error(ENOTSUP, std::system_category(),
+                "io_uring drops completions on overflow");
+        }
+
+        probe();
+
+        sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_size = params.cq_off.cqes  + params.cq_entries * sizeof(io_uring_cqe);
+
+        const bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+
+        if(single) {
+            sq_size = cq_size = std::max(sq_size, cq_size);
+        }
+
+        sq_ptr = ::mmap(nullptr, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+            IORING_OFF_SQ_RING);
+
+        if(sq_ptr == MAP_FAILED) {
+            throw std::system_error(errno, std::system_category(), "unable to map io_uring");
+        }
+
+        if(single) {
+            cq_ptr = sq_ptr;
+        } else {
+            cq_ptr = ::mmap(nullptr, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                fd, IORING_OFF_CQ_RING);
+
+            if(cq_ptr == MAP_FAILED) {
+                throw std::system_error(errno, std::system_category(), "unable to map io_uring");
+            }
+        }
+
+        sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+
+        sqes = static_cast<io_uring_sqe*>(::mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+
+        if(sqes == MAP_FAILED) {
+            throw std::system_error(errno, std::system_category(), "unable to map io_uring");
+        }
+    } catch(...) {
+        release();
+        throw;
+    }
+
+    sq_head    = offset<unsigned>(sq_ptr, params.sq_off.head);
+    sq_tail    = offset<unsigned>(sq_ptr, params.sq_off.tail);
+    sq_array   = offset<unsigned>(sq_ptr, params.sq_off.array);
+    sq_mask    = *offset<unsigned>(sq_ptr, params.sq_off.ring_mask);
+    sq_entries = params.sq_entries;
+
+    cq_head = offset<unsigned>(cq_ptr, params.cq_off.head);
+    cq_tail = offset<unsigned>(cq_ptr, params.cq_off.tail);
+    cq_mask = *offset<unsigned>(cq_ptr, params.cq_off.ring_mask);
+    cqes    = offset<io_uring_cqe>(cq_ptr, params.cq_off.cqes);
+
+    tail = *sq_tail;
+}
+
+uring_t::ring_t::~ring_t() {
+    release();
+}
+
+auto
+uring_t::ring_t::next() -> io_uring_sqe* {
+    if(tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) == sq_entries) {
+        return nullptr;
+    }
+
+    const unsigned index = tail++ & sq_mask;
+
+    sq_array[index] = index;
+
+    return &sqes[index];
+}
+
+void
+uring_t::ring_t::publish() {
+    __atomic_store_n(sq_tail, tail, __ATOMIC_RELEASE);
+}
+
+void
+uring_t::ring_t::probe() {
+    static const unsigned kOperations = 256;
+
+    std::vector<char> storage(sizeof(io_uring_probe) + kOperations * sizeof(io_uring_probe_op));
+
+    io_uring_probe* ptr = reinterpret_cast<io_uring_probe*>(storage.data());
+
+    if(::syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, ptr, kOperations) == -1) {
+        throw std::system_error(errno, std::system_category(), "unable to probe io_uring");
+    }
+
+    static const unsigned required[] = {
+        IORING_OP_POLL_ADD, IORING_OP_RECV, IORING_OP_SENDMSG, IORING_OP_ASYNC_CANCEL
+    };
+
+    for(auto it = std::begin(required); it != std::end(required); ++it) {
+        if(*it > ptr->last_op || !(ptr->ops[*it].flags & IO_URING_OP_SUPPORTED)) {
+            throw std::system_error(ENOTSUP, std::system_category(),
+                cocaine::format("io_uring doesn't support operation %d", *it));
+        }
+    }
+}
+
+void
+uring_t::ring_t::release() {
+    if(sqes != MAP_FAILED) {
+        ::munmap(sqes, sqes_size);
+    }
+
+    if(cq_ptr != MAP_FAILED && cq_ptr != sq_ptr) {
+        ::munmap(cq_ptr, cq_size);
+    }
+
+    if(sq_ptr != MAP_FAILED) {
+        ::munmap(sq_ptr, sq_size);
+    }
+
+    // NOTE: Closing the ring cancels all the operations still in flight.
+    if(fd != -1) {
+        ::close(fd);
+    }
+}
+
+// Rings
+
+uring_t::uring_t(asio::io_service& asio):
+    asio::io_service::service(asio),
+    m_ring(new ring_t()),
+    m_armed(false),
+    m_queued(0),
+    m_inflight(0),
+    m_scheduled(false),
+    m_stats()
+{
+    const int fd = ::dup(m_ring->fd);
+
+    if(fd == -1) {
+        throw std::system_error(errno, std::system_category(), "unable to clone io_uring fd");
+    }
+
+    try {
+        m_descriptor = std::make_unique<asio::posix::stream_descriptor>(asio, fd);
+    } catch(...) {
+        ::close(fd);
+        throw;
+    }
+}
+
+uring_t::~uring_t() {
+    // Empty.
+}
+
+auto
+uring_t::find(asio::io_service& asio) -> uring_t* {
+    if(!asio::has_service<uring_t>(asio)) {
+        return nullptr;
+    }
+
+    uring_t* ptr = &asio::use_service<uring_t>(asio);
+
+    return ptr->usable() ? ptr : nullptr;
+}
+
+auto
+uring_t::poll(int fd, handler_type handle) -> token_type {
+    const size_t index = allocate(std::move(handle), false);
+
+    enqueue(IORING_OP_POLL_ADD, fd, nullptr, 0, POLLIN, index);
+
+    return token(index);
+}
+
+auto
+uring_t::recv(int fd, void* data, size_t size, handler_type handle) -> token_type {
+    const size_t index = allocate(std::move(handle), size != 0);
+
+    enqueue(IORING_OP_RECV, fd, data, size, 0, index);
+
+    return token(index);
+}
+
+void
+uring_t::cancel(token_type token) {
+    const size_t index = static_cast<uint32_t>(token);
+
+    if(index >= m_slots.size() || !m_slots[index].handle ||
+       m_slots[index].generation != token >> 32)
+    {
+        // The operation has already completed, and the slot might be even reused by now.
+        return;
+    }
+
+    // NOTE: The cancellation itself is an operation too, its completion is ignored though.
+    enqueue(IORING_OP_ASYNC_CANCEL, -1, reinterpret_cast<const void*>(token), 0, 0,
+        allocate([](const std::error_code&, size_t) { }, false));
+}
+
+void
+uring_t::shutdown_service() {
+    m_descriptor.reset();
+
+    // NOTE: The rings are closed before the handlers are destroyed, because the handlers keep the
+    // streams alive, and the streams own the buffers the kernel might still write into.
+    m_ring.reset();
+
+    m_slots.clear();
+    m_free.clear();
+    m_backlog.clear();
+}
+
+auto
+uring_t::allocate(handler_type handle, bool stream) -> size_t {
+    size_t index;
+
+    if(!m_free.empty()) {
+        index = m_free.back();
+        m_free.pop_back();
+    } else {
+        index = m_slots.size();
+        m_slots.emplace_back();
+    }
+
+    m_slots[index].handle = std::move(handle);
+    m_slots[index].generation++;
+    m_slots[index].stream = stream;
+
+    return index;
+}
+
+auto
+uring_t::token(size_t index) const -> token_type {
+    return static_cast<token_type>(m_slots[index].generation) << 32 | index;
+}
+
+auto
+uring_t::sendmsg(int fd, size_t index) -> token_type {
+    slot_t& slot = m_slots[index];
+
+    std::memset(&slot.message, 0, sizeof(slot.message));
+
+    slot.message.msg_iov = slot.buffers.data();
+    slot.message.msg_iovlen = slot.buffers.size();
+
+    // The same flag asio uses, so that writing to a closed connection doesn't raise SIGPIPE.
+    enqueue(IORING_OP_SENDMSG, fd, &slot.message, 1, MSG_NOSIGNAL, index);
+
+    return token(index);
+}
+
+void
+uring_t::enqueue(unsigned opcode, int fd, const void* data, size_t size, unsigned flags,
+                 size_t index)
+{
+    if(!m_ring) {
+        return abort(index, m_error);
+    }
+
+    // NOTE: Once there's a backlog, the new entries go after it, so that the operations are
+    // submitted in order. A cancellation must never overtake the operation it cancels.
+    io_uring_sqe* sqe = m_backlog.empty() ? m_ring->next() : nullptr;
+
+    if(sqe) {
+        prepare(sqe, opcode, fd, data, size, flags, token(index));
+        m_ring->publish();
+        m_queued++;
+    } else {
+        m_backlog.push_back(entry_t{opcode, fd, data, size, flags, index});
+    }
+
+    m_inflight++;
+
+    m_stats.operations++;
+
+    arm();
+    schedule();
+}
+
+void
+uring_t::refill() {
+    io_uring_sqe* sqe;
+
+    while(!m_backlog.empty() && (sqe = m_ring->next()) != nullptr) {
+        const entry_t& entry = m_backlog.front();
+
+        prepare(sqe, entry.opcode, entry.fd, entry.data, entry.size, entry.flags,
+            token(entry.index));
+
+        m_backlog.pop_front();
+        m_queued++;
+    }
+
+    m_ring->publish();
+}
+
+void
+uring_t::schedule() {
+    if(m_scheduled) {
+        return;
+    }
+
+    m_scheduled = true;
+
+    // Let all the operations queued during this reactor turn be submitted together.
+    get_io_service().post([this] {
+        m_scheduled = false;
+        submit();
+    });
+}
+
+void
+uring_t::submit() {
+    while(m_ring) {
+        refill();
+
+        if(!m_queued) {
+            return;
+        }
+
+        const int submitted = ::syscall(__NR_io_uring_enter, m_ring->fd, m_queued, 0, 0, nullptr,
+            0);
+
+        if(submitted > 0) {
+            m_queued -= submitted;
+            m_stats.submissions++;
+            continue;
+        }
+
+        if(submitted == -1 && errno == EINTR) {
+            continue;
+        }
+
+        if(submitted == 0 || errno == EAGAIN || errno == EBUSY) {
+            // The kernel is short on resources or the completions backlog is too large, so make
+            // some room and retry during the next reactor turn.
+            drain();
+            return schedule();
+        }
+
+        return fail(std::error_code(errno, std::system_category()));
+    }
+}
+
+void
+uring_t::arm() {
+    if(m_armed || !m_inflight || !m_descriptor) {
+        return;
+    }
+
+    m_armed = true;
+
+    m_descriptor->async_read_some(asio::null_buffers(), std::bind(&uring_t::reap, this,
+        std::placeholders::_1));
+}
+
+void
+uring_t::reap(const std::error_code& ec) {
+    m_armed = false;
+
+    if(ec == asio::error::operation_aborted) {
+        return;
+    }
+
+    if(ec) {
+        return fail(ec);
+    }
+
+    drain();
+    arm();
+}
+
+void
+uring_t::abort(size_t index, const std::error_code& ec) {
+    handler_type handle = std::move(m_slots[index].handle);
+
+    m_slots[index].handle = nullptr;
+    m_free.push_back(index);
+
+    get_io_service().post(std::bind(std::move(handle), ec, 0));
+}
+
+void
+uring_t::fail(const std::error_code& ec) {
+    // The operations which have already completed are reported as usual, so that none of them is
+    // retried after it has actually happened.
+    drain();
+
+    m_error = ec;
+
+    // NOTE: Same order as in shutdown_service(), the handlers outlive the rings.
+    m_descriptor.reset();
+    m_ring.reset();
+
+    m_backlog.clear();
+
+    m_queued = 0;
+    m_inflight = 0;
+
+    for(size_t index = 0; index < m_slots.size(); ++index) {
+        if(m_slots[index].handle) {
+            abort(index, asio::error::try_again);
+        }
+    }
+}
+
+void
+uring_t::drain() {
+    if(!m_ring) {
+        return;
+    }
+
+    unsigned head = *m_ring->cq_head;
+
+    // NOTE: The completion queue is re-read after every batch, because the handlers might submit
+    // new operations, which might complete inline.
+    for(unsigned tail; head != (tail = __atomic_load_n(m_ring->cq_tail, __ATOMIC_ACQUIRE));) {
+        while(head != tail) {
+            const io_uring_cqe& cqe = m_ring->cqes[head++ & m_ring->cq_mask];
+
+            const size_t index = static_cast<uint32_t>(cqe.user_data);
+            const int result = cqe.res;
+
+            // Let the kernel reuse the entry before the handler is invoked.
+            __atomic_store_n(m_ring->cq_head, head, __ATOMIC_RELEASE);
+
+            slot_t& slot = m_slots[index];
+
+            handler_type handle = std::move(slot.handle);
+            const bool stream = slot.stream;
+
+            slot.handle = nullptr;
+            m_free.push_back(index);
+            m_inflight--;
+
+            if(result < 0) {
+                handle(std::error_code(-result, std::system_category()), 0);
+            } else if(result == 0 && stream) {
+                handle(asio::error::eof, 0);
+            } else {
+                handle(std::error_code(), static_cast<size_t>(result));
+            }
+        }
+    }
+}
+
+#else
+
+// Stubs for the platforms without io_uring, the constructor always throws.
+
+struct uring_t::ring_t { };
+
+uring_t::uring_t(asio::io_service& asio):
+    asio::io_service::service(asio)
+{
+    throw std::system_error(ENOTSUP, std::system_category(), "io_uring is not supported");
+}
+
+uring_t::~uring_t() {
+    // Empty.
+}
+
+auto
+uring_t::find(asio::io_service& asio) -> uring_t* {
+    if(!asio::has_service<uring_t>(asio)) {
+        return nullptr;
+    }
+
+    uring_t* ptr = &asio::use_service<uring_t>(asio);
+
+    return ptr->usable() ? ptr : nullptr;
+}
+
+auto
+uring_t::poll(int, handler_type) -> token_type {
+    BOOST_ASSERT(false);
+    return 0;
+}
+
+auto
+uring_t::recv(int, void*, size_t, handler_type) -> token_type {
+    BOOST_ASSERT(false);
+    return 0;
+}
+
+void
+uring_t::cancel(token_type) {
+    BOOST_ASSERT(false);
+}
+
+void
+uring_t::shutdown_service() {
+    // Empty.
+}
+
+auto
+uring_t::allocate(handler_type, bool) -> size_t {
+    BOOST_ASSERT(false);
+    return 0;
+}
+
+auto
+uring_t::token(size_t) const -> token_type {
+    BOOST_ASSERT(false);
+    return 0;
+}
+
+auto
+uring_t::sendmsg(int, size_t) -> token_type {
+    BOOST_ASSERT(false);
+    return 0;
+}
+
+#endif
@@ -12,9 +12,12 @@
 
 #include "cocaine/logging.hpp"
 
+#include "cocaine/rpc/asio/writable_stream.hpp"
 #include "cocaine/rpc/dispatch.hpp"
 
+#include <iostream>
 #include <random>
+#include <tuple>
 
 #include <celero/Celero.h>
 
@@ -70,6 +73,22 @@ struct test {
             std::string
         >::tag upstream_type;
     };
+
+    struct stream_slot {
+        typedef test_tag tag;
+
+        static const char* alias() {
+            return "stream_slot";
+        }
+
+        typedef boost::mpl::list<
+            std::string
+        > argument_type;
+
+        typedef stream_of<
+            std::string
+        >::tag upstream_type;
+    };
 };
 
 template<>
@@ -81,7 +100,8 @@ struct protocol<test_tag> {
     typedef boost::mpl::list<
         test::mute_slot,
         test::void_slot,
-        test::echo_slot
+        test::echo_slot,
+        test::stream_slot
     > messages;
 
     typedef test scope;
@@ -100,6 +120,7 @@ struct test_service_t:
         on<io::test::mute_slot>(std::bind(&test_service_t::on_mute_slot, this, _1));
         on<io::test::void_slot>(std::bind(&test_service_t::on_void_slot, this, _1));
         on<io::test::echo_slot>(std::bind(&test_service_t::on_echo_slot, this, _1));
+        on<io::test::stream_slot>(std::bind(&test_service_t::on_stream_slot, this, _1));
     }
 
     void
@@ -116,6 +137,18 @@ struct test_service_t:
     on_echo_slot(const std::string& input) {
         return input;
     }
+
+    streamed<std::string>
+    on_stream_slot(const std::string& input) {
+        streamed<std::string> stream;
+
+        // Every chunk is a separate message pushed to the session during the same reactor turn.
+        for(int i = 0; i < 50; ++i) {
+            stream.write(input);
+        }
+
+        return stream.close();
+    }
 };
 
 } // namespace cocaine
@@ -142,6 +175,8 @@ globals() {
 struct test_fixture_t:
     public celero::TestFixture
 {
+    const std::string config;
+
     std::unique_ptr<cocaine::context_t> context;
     std::unique_ptr<asio::io_service> reactor;
     std::unique_ptr<boost::thread> chamber;
@@ -149,10 +184,14 @@ struct test_fixture_t:
     cocaine::api::client<cocaine::io::test_tag> service;
 
 public:
+    test_fixture_t(const std::string& config_ = "cocaine-benchmark.conf"):
+        config(config_)
+    { }
+
     virtual
     void
     setUp(int64_t) {
-        context.reset(new cocaine::context_t(cocaine::config_t("cocaine-benchmark.conf"), "core"));
+        context.reset(new cocaine::context_t(cocaine::config_t(config), "core"));
         reactor.reset(new asio::io_service());
 
         context->insert("benchmark", std::make_unique<cocaine::actor_t>(
@@ -215,4 +254,130 @@ BENCHMARK_F(ClientIoBenchmark65K, EchoSlot, test_fixture_t, 10, 100000) {
     service.invoke<cocaine::io::test::echo_slot>(nullptr, globals().data65K);
 }
 
+// NOTE: The coalescing configuration enables write coalescing for the "benchmark" service in the
+// "network.transports" section. Both fixtures report the number of write calls the execution units
+// have issued per outbound message, to compare them with and without coalescing.
+
+struct stream_fixture_t:
+    public test_fixture_t
+{
+    uint64_t messages;
+    uint64_t writes;
+
+public:
+    stream_fixture_t(const std::string& config = "cocaine-benchmark.conf"):
+        test_fixture_t(config)
+    { }
+
+    virtual
+    void
+    setUp(int64_t value) {
+        test_fixture_t::setUp(value);
+        std::tie(messages, writes) = outbound();
+    }
+
+    virtual
+    void
+    tearDown() {
+        uint64_t total_messages, total_writes;
+
+        std::tie(total_messages, total_writes) = outbound();
+
+        if(total_messages != messages) {
+            std::cout << config << ": "
+                      << double(total_writes - writes) / (total_messages - messages)
+                      << " write(s) per message" << std::endl;
+        }
+
+        test_fixture_t::tearDown();
+    }
+
+private:
+    auto
+    outbound() const -> std::tuple<uint64_t, uint64_t> {
+        uint64_t queued = 0, issued = 0;
+
+        const auto& engines = context->engines();
+
+        for(auto it = engines.begin(); it != engines.end(); ++it) {
+            queued += (*it)->outbound().messages.load();
+            issued += (*it)->outbound().writes.load();
+        }
+
+        return std::make_tuple(queued, issued);
+    }
+};
+
+struct coalescing_fixture_t:
+    public stream_fixture_t
+{
+    coalescing_fixture_t():
+        stream_fixture_t("cocaine-benchmark-coalescing.conf")
+    { }
+};
+
+BASELINE_F (ClientIoBenchmarkStream1K, StreamSlot,           stream_fixture_t,     10, 10000) {
+    service.invoke<cocaine::io::test::stream_slot>(nullptr, globals().data1K);
+}
+
+BENCHMARK_F(ClientIoBenchmarkStream1K, CoalescedStreamSlot,  coalescing_fixture_t, 10, 10000) {
+    service.invoke<cocaine::io::test::stream_slot>(nullptr, globals().data1K);
+}
+
+// NOTE: These keep 10000 idle connections to the service besides the benchmarked one, so that the
+// execution units have plenty of sessions to wait on. The io_uring configuration sets the
+// "network.backend" option to "io_uring", the baseline one leaves it at the default reactor. The
+// open files limit must be raised accordingly.
+
+struct crowded_fixture_t:
+    public test_fixture_t
+{
+    static const size_t kConnections = 10000;
+
+    std::vector<std::unique_ptr<asio::ip::tcp::socket>> crowd;
+
+public:
+    crowded_fixture_t(const std::string& config = "cocaine-benchmark.conf"):
+        test_fixture_t(config)
+    { }
+
+    virtual
+    void
+    setUp(int64_t value) {
+        test_fixture_t::setUp(value);
+
+        auto endpoints = context->locate("benchmark").get().endpoints();
+
+        for(size_t i = 0; i < kConnections; ++i) {
+            auto socket = std::make_unique<asio::ip::tcp::socket>(*reactor);
+
+            asio::connect(*socket, endpoints.begin(), endpoints.end());
+            crowd.push_back(std::move(socket));
+        }
+    }
+
+    virtual
+    void
+    tearDown() {
+        crowd.clear();
+        test_fixture_t::tearDown();
+    }
+};
+
+struct uring_fixture_t:
+    public crowded_fixture_t
+{
+    uring_fixture_t():
+        crowded_fixture_t("cocaine-benchmark-uring.conf")
+    { }
+};
+
+BASELINE_F (ClientIoBenchmarkCrowd1K, EchoSlot,      crowded_fixture_t, 10, 100000) {
+    service.invoke<cocaine::io::test::echo_slot>(nullptr, globals().data1K);
+}
+
+BENCHMARK_F(ClientIoBenchmarkCrowd1K, UringEchoSlot, uring_fixture_t,   10, 100000) {
+    service.invoke<cocaine::io::test::echo_slot>(nullptr, globals().data1K);
+}
+
 CELERO_MAIN
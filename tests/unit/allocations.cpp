@@ -0,0 +1,81 @@
+/*
+    Copyright (c) 2011-2015 Andrey Sibiryov <me@kobology.ru>
+    Copyright (c) 2011-2015 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "stream_pair.hpp"
+
+#include <cocaine/idl/streaming.hpp>
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// NOTE: These tests replace the global allocator to count the allocations, so they're built into a
+// separate executable, not to affect the other tests.
+
+using namespace cocaine::io;
+
+namespace {
+
+typedef streaming<boost::mpl::list<std::string>::type>::chunk chunk_type;
+
+// Only enabled while the code under test is running.
+std::atomic<bool> counting(false);
+std::atomic<size_t> allocations(0);
+
+} // namespace
+
+void*
+operator new(size_t size) {
+    if(counting) {
+        ++allocations;
+    }
+
+    if(void* ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+
+    throw std::bad_alloc();
+}
+
+void
+operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+TEST_F(stream_pair_test, writes_without_allocations) {
+    auto roundtrip = [&](size_t count) {
+        for(size_t i = 0; i < count; ++i) {
+            stream->write(encoded<chunk_type>(1, std::string("short")));
+        }
+
+        while(stream->pressure()) {
+            receive();
+        }
+    };
+
+    // Let the queues and the encoder grow their storage and fill the spare buffers.
+    roundtrip(64);
+
+    counting = true;
+    roundtrip(64);
+    counting = false;
+
+    ASSERT_EQ(0u, allocations.load());
+}
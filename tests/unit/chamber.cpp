@@ -0,0 +1,58 @@
+/*
+    Copyright (c) 2011-2015 Andrey Sibiryov <me@kobology.ru>
+    Copyright (c) 2011-2015 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cocaine/detail/chamber.hpp>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <asio/io_service.hpp>
+
+#include <thread>
+
+using namespace cocaine;
+using namespace cocaine::io;
+
+TEST(chamber, spins_and_parks) {
+    const auto asio = std::make_shared<asio::io_service>();
+
+    std::atomic<bool> handled(false);
+
+    chamber_t chamber("test", asio, affinity_t(), polling_t{true, std::chrono::microseconds(100)});
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+
+    asio->post([&] { handled = true; });
+
+    while(!handled && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // The thread runs out of its spin budget between the wakeups, and the time it has been parked
+    // for is published as soon as it parks again.
+    while(!chamber.polling().parked.load() && std::chrono::steady_clock::now() < deadline) {
+        asio->post([] { });
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    EXPECT_TRUE(handled);
+    EXPECT_GT(chamber.polling().spinning.load(), 0u);
+    EXPECT_GT(chamber.polling().parked.load(), 0u);
+}
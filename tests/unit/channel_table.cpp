@@ -0,0 +1,118 @@
+/*
+    Copyright (c) 2011-2015 Andrey Sibiryov <me@kobology.ru>
+    Copyright (c) 2011-2015 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cocaine/rpc/channel_table.hpp>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <map>
+#include <random>
+
+using namespace cocaine::io;
+
+TEST(channel_table, insert_find_erase) {
+    channel_table<std::string> table;
+
+    ASSERT_TRUE(table.empty());
+    ASSERT_EQ(nullptr, table.find(1));
+
+    table.insert(1, "first");
+    table.insert(17, "colliding");
+
+    ASSERT_EQ(2u, table.size());
+    ASSERT_EQ("first", *table.find(1));
+    ASSERT_EQ("colliding", *table.find(17));
+
+    ASSERT_TRUE(table.erase(1));
+    ASSERT_FALSE(table.erase(1));
+
+    // The colliding entry must still be reachable after its predecessor has been erased.
+    ASSERT_EQ("colliding", *table.find(17));
+    ASSERT_EQ(1u, table.size());
+}
+
+TEST(channel_table, matches_ordered_map) {
+    channel_table<uint64_t> table;
+    std::map<uint64_t, uint64_t> reference;
+
+    std::mt19937 random(42);
+
+    uint64_t channel_id = 1;
+
+    for(size_t i = 0; i < 20000; ++i) {
+        if(random() % 3 || reference.empty()) {
+            // Mostly sequential ids with occasional gaps, like the real clients do.
+            channel_id += random() % 8 ? 1 : 1 + random() % 1000;
+
+            table.insert(channel_id, channel_id);
+            reference[channel_id] = channel_id;
+        } else {
+            auto it = reference.begin();
+            std::advance(it, random() % reference.size());
+
+            ASSERT_TRUE(table.erase(it->first));
+            reference.erase(it);
+        }
+    }
+
+    ASSERT_EQ(reference.size(), table.size());
+
+    for(auto it = reference.begin(); it != reference.end(); ++it) {
+        ASSERT_NE(nullptr, table.find(it->first));
+        ASSERT_EQ(it->second, *table.find(it->first));
+    }
+
+    size_t visited = 0;
+
+    table.visit([&](uint64_t id, uint64_t value) {
+        ASSERT_EQ(id, value);
+        visited++;
+    });
+
+    ASSERT_EQ(reference.size(), visited);
+}
+
+TEST(channel_table, stays_flat_under_churn) {
+    channel_table<uint64_t> table;
+
+    uint64_t channel_id = 0;
+
+    // Long-lived connection with fire-and-forget calls: channels are opened in bursts of varying
+    // size and every one of them is torn down shortly after.
+    for(size_t round = 0; round < 1000; ++round) {
+        const size_t burst = 1 + (round * 7919) % 512;
+        const uint64_t first = channel_id + 1;
+
+        for(size_t i = 0; i < burst; ++i) {
+            channel_id++;
+            table.insert(channel_id, channel_id);
+        }
+
+        ASSERT_EQ(burst, table.size());
+
+        for(uint64_t id = first; id <= channel_id; ++id) {
+            ASSERT_TRUE(table.erase(id));
+        }
+
+        ASSERT_TRUE(table.empty());
+        ASSERT_GE(16u, table.capacity());
+    }
+}
@@ -0,0 +1,133 @@
+/*
+    Copyright (c) 2011-2015 Andrey Sibiryov <me@kobology.ru>
+    Copyright (c) 2011-2015 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cocaine/idl/streaming.hpp>
+
+#include <cocaine/rpc/asio/decoder.hpp>
+#include <cocaine/rpc/asio/encoder.hpp>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <iterator>
+
+using namespace cocaine;
+using namespace cocaine::io;
+
+namespace {
+
+typedef streaming<boost::mpl::list<std::string>::type>::chunk chunk_type;
+
+std::string
+encode(encoder_t& encoder, uint64_t channel_id, const std::string& payload) {
+    encoded<chunk_type> message(channel_id, payload);
+
+    const auto encoded = encoder.encode(message);
+
+    std::vector<asio::const_buffer> buffers;
+    std::string result;
+
+    encoded.buffers(std::back_inserter(buffers));
+
+    for(auto it = buffers.begin(); it != buffers.end(); ++it) {
+        result.append(asio::buffer_cast<const char*>(*it), asio::buffer_size(*it));
+    }
+
+    return result;
+}
+
+} // namespace
+
+TEST(decoder_t, chunked_frame) {
+    encoder_t encoder;
+    decoder_t decoder;
+
+    const std::string payload(1024 * 1024, 'x');
+    const std::string frame = encode(encoder, 1, payload);
+
+    decoder_t::message_type message;
+    std::error_code ec;
+
+    // Feed the frame in 64 KB chunks, as the readable stream would do.
+    for(size_t size = 65536; size < frame.size(); size += 65536) {
+        ASSERT_EQ(0u, decoder.decode(frame.data(), size, message, ec));
+        ASSERT_EQ(error::insufficient_bytes, ec);
+
+        ec.clear();
+    }
+
+    ASSERT_EQ(frame.size(), decoder.decode(frame.data(), frame.size(), message, ec));
+    ASSERT_FALSE(ec);
+
+    ASSERT_EQ(payload, message.args().via.array.ptr[0].as<std::string>());
+}
+
+TEST(decoder_t, declared_length) {
+    encoder_t encoder;
+    decoder_t decoder;
+
+    const std::string payload(1024 * 1024, 'x');
+    const std::string frame = encode(encoder, 1, payload);
+
+    decoder_t::message_type message;
+    std::error_code ec;
+
+    // The payload length is known from the first chunk already.
+    ASSERT_EQ(0u, decoder.decode(frame.data(), 65536, message, ec));
+    ASSERT_EQ(error::insufficient_bytes, ec);
+
+    ASSERT_GT(decoder.expected(), payload.size());
+    ASSERT_LE(decoder.expected(), frame.size());
+}
+
+TEST(decoder_t, pipelined_frames) {
+    encoder_t encoder;
+    decoder_t decoder;
+
+    const std::string stream = encode(encoder, 1, "first") + encode(encoder, 2, "second");
+
+    decoder_t::message_type message;
+    std::error_code ec;
+
+    const size_t offset = decoder.decode(stream.data(), stream.size(), message, ec);
+
+    ASSERT_FALSE(ec);
+    ASSERT_EQ(1u, message.span());
+    ASSERT_EQ("first", message.args().via.array.ptr[0].as<std::string>());
+
+    ASSERT_EQ(stream.size() - offset,
+        decoder.decode(stream.data() + offset, stream.size() - offset, message, ec));
+    ASSERT_FALSE(ec);
+    ASSERT_EQ(2u, message.span());
+    ASSERT_EQ("second", message.args().via.array.ptr[0].as<std::string>());
+}
+
+TEST(decoder_t, malformed_frame) {
+    decoder_t decoder;
+
+    const char frame[] = { '\x93', '\xc1', '\x00', '\x90' };
+
+    decoder_t::message_type message;
+    std::error_code ec;
+
+    decoder.decode(frame, sizeof(frame), message, ec);
+
+    ASSERT_EQ(error::parse_error, ec);
+}
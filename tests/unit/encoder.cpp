@@ -0,0 +1,94 @@
+/*
+    Copyright (c) 2011-2015 Andrey Sibiryov <me@kobology.ru>
+    Copyright (c) 2011-2015 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cocaine/idl/streaming.hpp>
+
+#include <cocaine/rpc/asio/decoder.hpp>
+#include <cocaine/rpc/asio/encoder.hpp>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <iterator>
+
+using namespace cocaine::io;
+
+namespace {
+
+typedef streaming<boost::mpl::list<std::string>::type>::chunk chunk_type;
+
+std::string
+flatten(const encoder_t::encoded_message_type& encoded) {
+    std::vector<asio::const_buffer> buffers;
+    std::string result;
+
+    encoded.buffers(std::back_inserter(buffers));
+
+    for(auto it = buffers.begin(); it != buffers.end(); ++it) {
+        result.append(asio::buffer_cast<const char*>(*it), asio::buffer_size(*it));
+    }
+
+    return result;
+}
+
+} // namespace
+
+TEST(encoded_message_t, small_arguments_are_copied) {
+    encoder_t encoder;
+    encoded<chunk_type> message(1, std::string(1024, 'x'));
+
+    const auto encoded = encoder.encode(message);
+
+    ASSERT_EQ(1u, encoded.count());
+    ASSERT_EQ(flatten(encoded).size(), encoded.size());
+}
+
+TEST(encoded_message_t, large_arguments_are_referenced) {
+    encoder_t encoder;
+    decoder_t decoder;
+
+    const std::string payload(65536, 'x');
+
+    encoded<chunk_type> message(1, payload);
+
+    const auto encoded = encoder.encode(message);
+
+    ASSERT_EQ(3u, encoded.count());
+
+    std::vector<asio::const_buffer> buffers;
+    encoded.buffers(std::back_inserter(buffers));
+
+    // The payload itself is not a part of the packed header.
+    ASSERT_EQ(payload.size(), asio::buffer_size(buffers[1]));
+    ASSERT_LT(asio::buffer_size(buffers[0]) + asio::buffer_size(buffers[2]), 2048u);
+
+    const auto flat = flatten(encoded);
+
+    ASSERT_EQ(flat.size(), encoded.size());
+
+    decoder_t::message_type decoded;
+    std::error_code ec;
+
+    ASSERT_EQ(flat.size(), decoder.decode(flat.data(), flat.size(), decoded, ec));
+    ASSERT_FALSE(ec);
+
+    ASSERT_EQ(1u, decoded.span());
+    ASSERT_EQ(payload, decoded.args().via.array.ptr[0].as<std::string>());
+}
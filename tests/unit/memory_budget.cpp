@@ -0,0 +1,91 @@
+/*
+    Copyright (c) 2011-2015 Andrey Sibiryov <me@kobology.ru>
+    Copyright (c) 2011-2015 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cocaine/rpc/asio/memory_budget.hpp>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+using namespace cocaine::io;
+
+TEST(memory_budget, propagates_to_parent) {
+    auto process = std::make_shared<memory_budget_t>(1024);
+    auto engine  = std::make_shared<memory_budget_t>(0, process);
+
+    engine->charge(512);
+
+    ASSERT_EQ(512u, engine->usage());
+    ASSERT_EQ(512u, process->usage());
+    ASSERT_FALSE(engine->exceeded());
+
+    engine->charge(1024);
+
+    ASSERT_TRUE(process->exceeded());
+    ASSERT_TRUE(engine->exceeded());
+
+    engine->discharge(1536);
+
+    ASSERT_EQ(0u, process->usage());
+    ASSERT_EQ(1536u, process->peak());
+    ASSERT_FALSE(engine->exceeded());
+}
+
+TEST(memory_charge, follows_usage_and_rebinds) {
+    auto source = std::make_shared<memory_budget_t>();
+    auto target = std::make_shared<memory_budget_t>();
+
+    {
+        memory_charge_t charge;
+
+        // Tracked without a budget, charged once bound.
+        charge.update(100);
+        charge.rebind(source);
+
+        ASSERT_EQ(100u, source->usage());
+
+        charge.update(40);
+
+        ASSERT_EQ(40u, source->usage());
+
+        charge.rebind(target);
+
+        ASSERT_EQ(0u, source->usage());
+        ASSERT_EQ(40u, target->usage());
+    }
+
+    ASSERT_EQ(0u, target->usage());
+    ASSERT_EQ(100u, source->peak());
+}
+
+TEST(memory_budget, reparent_moves_usage) {
+    auto source = std::make_shared<memory_budget_t>();
+    auto target = std::make_shared<memory_budget_t>();
+    auto session = std::make_shared<memory_budget_t>(0, source);
+
+    session->charge(300);
+    session->reparent(target);
+
+    ASSERT_EQ(0u, source->usage());
+    ASSERT_EQ(300u, target->usage());
+
+    session->discharge(300);
+
+    ASSERT_EQ(0u, target->usage());
+}
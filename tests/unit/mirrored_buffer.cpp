@@ -0,0 +1,52 @@
+/*
+    Copyright (c) 2011-2015 Andrey Sibiryov <me@kobology.ru>
+    Copyright (c) 2011-2015 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cocaine/rpc/asio/mirrored_buffer.hpp>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <cstring>
+
+using namespace cocaine::io;
+
+TEST(mirrored_buffer_t, wraps_around) {
+    mirrored_buffer_t buffer(65536);
+
+    ASSERT_EQ(65536u, buffer.size());
+
+    // Write across the end of the first half, then read it back from the start of the buffer.
+    std::memcpy(buffer.data() + buffer.size() - 3, "hello", 5);
+
+    ASSERT_EQ(0, std::memcmp(buffer.data(), "lo", 2));
+    ASSERT_EQ(0, std::memcmp(buffer.data() + buffer.size() - 3, "hello", 5));
+}
+
+TEST(mirrored_buffer_t, discard) {
+    mirrored_buffer_t buffer(1);
+
+    ASSERT_LE(1u, buffer.size());
+
+    buffer.data()[0] = 'x';
+    buffer.discard();
+
+    ASSERT_EQ('\0', buffer.data()[0]);
+    ASSERT_EQ('\0', buffer.data()[buffer.size()]);
+}
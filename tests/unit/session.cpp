@@ -0,0 +1,142 @@
+/*
+    Copyright (c) 2011-2015 Andrey Sibiryov <me@kobology.ru>
+    Copyright (c) 2011-2015 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cocaine/idl/streaming.hpp>
+
+#include <cocaine/rpc/asio/transport.hpp>
+#include <cocaine/rpc/dispatch.hpp>
+#include <cocaine/rpc/session.hpp>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <asio/io_service.hpp>
+#include <asio/local/connect_pair.hpp>
+#include <asio/local/stream_protocol.hpp>
+
+#include <blackhole/handler.hpp>
+#include <blackhole/root.hpp>
+
+using namespace cocaine;
+using namespace cocaine::io;
+
+namespace {
+
+typedef streaming<boost::mpl::list<std::string>::type>::chunk chunk_type;
+typedef asio::local::stream_protocol protocol_type;
+
+// Accepts every invocation and stays in a state where nothing else can be received, the same as
+// the dispatches reached by the mute slots.
+class mute_dispatch_t:
+    public basic_dispatch_t
+{
+public:
+    mute_dispatch_t():
+        basic_dispatch_t("mute")
+    { }
+
+    virtual
+    boost::optional<dispatch_ptr_t>
+    process(const decoder_t::message_type&, const upstream_ptr_t&) const {
+        return boost::none;
+    }
+
+    virtual
+    auto
+    root() const -> const graph_root_t& {
+        static const graph_root_t empty;
+        return empty;
+    }
+
+    virtual
+    int
+    version() const {
+        return 1;
+    }
+};
+
+} // namespace
+
+TEST(session, reclaims_mute_channels) {
+    asio::io_service asio, remote;
+
+    auto server = std::make_unique<protocol_type::socket>(asio);
+    auto client = std::make_unique<protocol_type::socket>(remote);
+
+    asio::local::connect_pair(*server, *client);
+
+    std::unique_ptr<logging::logger_t> log(new blackhole::root_logger_t(
+        std::vector<std::unique_ptr<blackhole::handler_t>>()));
+
+    const auto mute = std::make_shared<mute_dispatch_t>();
+
+    const auto session = std::make_shared<cocaine::session<protocol_type>>(std::move(log),
+        std::make_unique<transport<protocol_type>>(std::move(server)), mute);
+
+    transport<protocol_type> peer(std::move(client));
+
+    session->pull();
+
+    uint64_t channel_id = 0;
+    size_t capacity = 0;
+
+    // Long-lived connection with fire-and-forget calls, each one on a new channel.
+    for(size_t round = 0; round < 100; ++round) {
+        for(size_t i = 0; i < 100; ++i) {
+            peer.writer->write(encoded<chunk_type>(++channel_id, std::string("call")));
+        }
+
+        while(session->channel_stats().reclaimed < channel_id) {
+            ASSERT_TRUE(session->is_attached());
+
+            asio.reset();
+            asio.poll();
+            remote.reset();
+            remote.poll();
+        }
+
+        const auto stats = session->channel_stats();
+
+        ASSERT_EQ(0u, stats.active);
+        ASSERT_EQ(channel_id, stats.reclaimed);
+
+        if(round == 0) {
+            capacity = stats.capacity;
+        }
+
+        ASSERT_EQ(capacity, stats.capacity);
+    }
+
+    // The channels forked with such a dispatch are never even registered.
+    for(size_t i = 0; i < 100; ++i) {
+        session->fork(mute);
+    }
+
+    const auto stats = session->channel_stats();
+
+    EXPECT_EQ(0u, stats.active);
+    EXPECT_EQ(capacity, stats.capacity);
+    EXPECT_EQ(channel_id + 100, stats.reclaimed);
+
+    session->detach(std::error_code());
+
+    asio.reset();
+    asio.poll();
+}
@@ -0,0 +1,78 @@
+/*
+    Copyright (c) 2011-2015 Andrey Sibiryov <me@kobology.ru>
+    Copyright (c) 2011-2015 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef COCAINE_TESTS_STREAM_PAIR_HPP
+#define COCAINE_TESTS_STREAM_PAIR_HPP
+
+#include <cocaine/rpc/asio/encoder.hpp>
+#include <cocaine/rpc/asio/writable_stream.hpp>
+
+#include <gtest/gtest.h>
+
+#include <asio/io_service.hpp>
+#include <asio/local/connect_pair.hpp>
+#include <asio/local/stream_protocol.hpp>
+
+#include <vector>
+
+// Writable stream over one end of a connected socket pair, the other end is read by the test.
+
+class stream_pair_test:
+    public ::testing::Test
+{
+protected:
+    typedef asio::local::stream_protocol::socket socket_type;
+    typedef cocaine::io::writable_stream<asio::local::stream_protocol, cocaine::io::encoder_t>
+        stream_type;
+
+    asio::io_service reactor;
+
+    const std::shared_ptr<socket_type> client;
+    const std::shared_ptr<socket_type> server;
+
+    std::shared_ptr<stream_type> stream;
+
+    // Receives the data read from the client side.
+    std::vector<char> sink;
+
+    stream_pair_test():
+        client(std::make_shared<socket_type>(reactor)),
+        server(std::make_shared<socket_type>(reactor)),
+        sink(65536)
+    {
+        asio::local::connect_pair(*client, *server);
+        server->non_blocking(true);
+
+        stream = std::make_shared<stream_type>(server);
+    }
+
+    // Reads whatever has been written so far into the sink, then lets the stream write some more.
+    // Returns the number of bytes read.
+    auto
+    receive() -> size_t {
+        const size_t size = client->read_some(asio::buffer(sink));
+
+        reactor.poll();
+
+        return size;
+    }
+};
+
+#endif
@@ -0,0 +1,339 @@
+/*
+    Copyright (c) 2011-2015 Andrey Sibiryov <me@kobology.ru>
+    Copyright (c) 2011-2015 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cocaine/idl/streaming.hpp>
+
+#include <cocaine/rpc/asio/transport.hpp>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <asio/io_service.hpp>
+#include <asio/local/connect_pair.hpp>
+#include <asio/local/stream_protocol.hpp>
+
+#include <chrono>
+#include <future>
+#include <thread>
+
+using namespace cocaine;
+using namespace cocaine::io;
+
+namespace {
+
+typedef streaming<boost::mpl::list<std::string>::type>::chunk chunk_type;
+typedef transport<asio::local::stream_protocol> transport_type;
+
+auto
+receive(asio::io_service& asio, transport_type& transport) -> std::string {
+    decoder_t::message_type message;
+    std::error_code result = error::insufficient_bytes;
+
+    transport.reader->read(message, [&](const std::error_code& ec) { result = ec; });
+
+    while(result == error::insufficient_bytes) {
+        asio.run_one();
+    }
+
+    EXPECT_FALSE(result);
+
+    return message.args().via.array.ptr[0].as<std::string>();
+}
+
+// Sets up the shared memory rings between the transports, the local one being the server, and
+// starts reading a message on the server side with the result reported into the arguments. Returns
+// the client's channel, or nullptr if the platform doesn't support the rings.
+auto
+negotiate(asio::io_service& source, asio::io_service& remote, transport_type& local,
+          transport_type& peer, decoder_t::message_type& message, std::error_code& result)
+    -> std::shared_ptr<shared_channel_t>
+{
+    local.reader->shared(64 << 10);
+
+    result = error::insufficient_bytes;
+
+    local.reader->read(message, [&result](const std::error_code& ec) { result = ec; });
+
+    // The client blocks until the rings are received, so the server has to run elsewhere.
+    std::thread negotiation([&] {
+        while(!local.writer->channel() && result == error::insufficient_bytes) {
+            source.run_one();
+        }
+
+        if(!local.writer->channel()) {
+            // Let the client know that the offer has failed.
+            local.socket->shutdown(asio::socket_base::shutdown_both);
+        }
+    });
+
+    std::shared_ptr<shared_channel_t> channel;
+
+    try {
+        channel = shared_channel_t::request(remote, peer.socket->native_handle());
+    } catch(const std::system_error&) {
+        channel = nullptr;
+    }
+
+    negotiation.join();
+
+    if(channel) {
+        peer.reader->attach(channel);
+        peer.writer->attach(channel);
+    }
+
+    return channel;
+}
+
+} // namespace
+
+TEST(transport, migrates_between_reactors) {
+    asio::io_service source, target, remote;
+
+    auto server = std::make_unique<asio::local::stream_protocol::socket>(source);
+    auto client = std::make_unique<asio::local::stream_protocol::socket>(remote);
+
+    asio::local::connect_pair(*server, *client);
+
+    transport_type local(std::move(server));
+    transport_type peer(std::move(client));
+
+    local.writer->write(encoded<chunk_type>(1, std::string("before")));
+    ASSERT_EQ("before", receive(remote, peer));
+
+    local.migrate(target);
+
+    ASSERT_EQ(&target, &local.socket->get_io_service());
+
+    // Both the connection and the header tables survive the migration.
+    local.writer->write(encoded<chunk_type>(1, std::string("after")));
+    ASSERT_EQ("after", receive(remote, peer));
+
+    peer.writer->write(encoded<chunk_type>(1, std::string("reply")));
+    ASSERT_EQ("reply", receive(target, local));
+}
+
+TEST(transport, exchanges_messages_over_io_uring) {
+    asio::io_service rings, remote;
+
+    try {
+        asio::add_service(rings, new uring_t(rings));
+    } catch(const std::system_error&) {
+        // The kernel doesn't support io_uring, so there's nothing to test.
+        return;
+    }
+
+    auto server = std::make_unique<asio::local::stream_protocol::socket>(rings);
+    auto client = std::make_unique<asio::local::stream_protocol::socket>(remote);
+
+    asio::local::connect_pair(*server, *client);
+
+    transport_type local(std::move(server));
+    transport_type peer(std::move(client));
+
+    // Way larger than the socket buffer, so that most of it is sent through the rings.
+    const std::string blob(4 << 20, 'x');
+
+    decoder_t::message_type message;
+    bool received = false;
+
+    peer.reader->read(message, [&](const std::error_code& ec) {
+        EXPECT_FALSE(ec);
+        received = true;
+    });
+
+    local.writer->write(encoded<chunk_type>(1, blob));
+
+    while(!received) {
+        // Both reactors might run out of work at times, which stops them.
+        rings.reset();
+        rings.poll();
+        remote.reset();
+        remote.poll();
+    }
+
+    EXPECT_EQ(blob, message.args().via.array.ptr[0].as<std::string>());
+
+    peer.writer->write(encoded<chunk_type>(1, std::string("reply")));
+    ASSERT_EQ("reply", receive(rings, local));
+
+    EXPECT_GT(uring_t::find(rings)->stats().submissions, 0u);
+}
+
+TEST(transport, cancels_io_uring_operations_when_destroyed) {
+    asio::io_service rings, remote;
+
+    try {
+        asio::add_service(rings, new uring_t(rings));
+    } catch(const std::system_error&) {
+        // The kernel doesn't support io_uring, so there's nothing to test.
+        return;
+    }
+
+    auto server = std::make_unique<asio::local::stream_protocol::socket>(rings);
+    auto client = std::make_unique<asio::local::stream_protocol::socket>(remote);
+
+    asio::local::connect_pair(*server, *client);
+
+    auto local = std::make_unique<transport_type>(std::move(server));
+    transport_type peer(std::move(client));
+
+    decoder_t::message_type message;
+    bool invoked = false;
+
+    local->reader->read(message, [&](const std::error_code&) { invoked = true; });
+
+    // Submits the wait, so that the idle connection has an operation in the kernel.
+    rings.poll();
+
+    // The same as a session being detached from an idle client, which stays connected.
+    local.reset();
+
+    std::promise<void> stopped;
+    auto future = stopped.get_future();
+
+    std::thread reactor([&] {
+        rings.reset();
+        rings.run();
+        stopped.set_value();
+    });
+
+    // The reactor runs out of work only once the wait is cancelled.
+    const auto status = future.wait_for(std::chrono::seconds(5));
+
+    if(status != std::future_status::ready) {
+        rings.stop();
+    }
+
+    reactor.join();
+
+    EXPECT_EQ(std::future_status::ready, status);
+    EXPECT_FALSE(invoked);
+}
+
+TEST(transport, exchanges_messages_over_shared_memory) {
+    asio::io_service source, remote;
+
+    auto server = std::make_unique<asio::local::stream_protocol::socket>(source);
+    auto client = std::make_unique<asio::local::stream_protocol::socket>(remote);
+
+    asio::local::connect_pair(*server, *client);
+
+    transport_type local(std::move(server));
+    transport_type peer(std::move(client));
+
+    decoder_t::message_type message;
+    std::error_code result;
+
+    if(!negotiate(source, remote, local, peer, message, result)) {
+        // The platform doesn't support either memfd_create(2) or eventfd(2).
+        return;
+    }
+
+    // Way larger than the rings, so that both sides have to wake each other up.
+    const std::string blob(1 << 20, 'x');
+
+    peer.writer->write(encoded<chunk_type>(1, blob));
+
+    while(result == error::insufficient_bytes) {
+        source.poll();
+        remote.poll();
+    }
+
+    ASSERT_FALSE(result);
+    EXPECT_EQ(blob, message.args().via.array.ptr[0].as<std::string>());
+
+    local.writer->write(encoded<chunk_type>(1, std::string("reply")));
+    ASSERT_EQ("reply", receive(remote, peer));
+}
+
+TEST(transport, rejects_corrupted_shared_memory) {
+    asio::io_service source, remote;
+
+    auto server = std::make_unique<asio::local::stream_protocol::socket>(source);
+    auto client = std::make_unique<asio::local::stream_protocol::socket>(remote);
+
+    asio::local::connect_pair(*server, *client);
+
+    transport_type local(std::move(server));
+    transport_type peer(std::move(client));
+
+    decoder_t::message_type message;
+    std::error_code result;
+
+    const auto channel = negotiate(source, remote, local, peer, message, result);
+
+    if(!channel) {
+        return;
+    }
+
+    const std::error_code expected(EPROTO, std::system_category());
+
+    std::error_code ec;
+
+    // Wakes the server up, the headers are corrupted right after that.
+    channel->write_some(asio::buffer("x", 1), ec);
+
+    // The client claims to have written way more than the ring can hold, and pretends to have read
+    // more than has been written to it.
+    channel->outbound().tail.fetch_add(1 << 30);
+    channel->inbound().head.fetch_add(1 << 30);
+
+    std::error_code failure;
+
+    local.writer->failed([&](const std::error_code& ec) { failure = ec; });
+    local.writer->write(encoded<chunk_type>(1, std::string("reply")));
+
+    while(result == error::insufficient_bytes || !failure) {
+        source.poll();
+    }
+
+    EXPECT_EQ(expected, result);
+    EXPECT_EQ(expected, failure);
+}
+
+TEST(transport, rejects_oversized_frames) {
+    asio::io_service asio;
+
+    auto server = std::make_unique<asio::local::stream_protocol::socket>(asio);
+    auto client = std::make_unique<asio::local::stream_protocol::socket>(asio);
+
+    asio::local::connect_pair(*server, *client);
+
+    transport_type local(std::move(server));
+    transport_type peer(std::move(client));
+
+    local.reader->limit(64 << 10);
+
+    peer.writer->write(encoded<chunk_type>(1, std::string(4 << 20, 'x')));
+
+    decoder_t::message_type message;
+    std::error_code result = error::insufficient_bytes;
+
+    local.reader->read(message, [&](const std::error_code& ec) { result = ec; });
+
+    while(result == error::insufficient_bytes) {
+        asio.run_one();
+    }
+
+    EXPECT_EQ(make_error_code(error::frame_too_large), result);
+
+    // The frame has been rejected long before it could be buffered completely.
+    EXPECT_LE(local.reader->pressure(), 256u << 10);
+}
@@ -0,0 +1,136 @@
+/*
+    Copyright (c) 2011-2015 Andrey Sibiryov <me@kobology.ru>
+    Copyright (c) 2011-2015 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "stream_pair.hpp"
+
+#include <cocaine/idl/control.hpp>
+#include <cocaine/idl/streaming.hpp>
+
+#include <cocaine/rpc/asio/decoder.hpp>
+
+#include <gmock/gmock.h>
+
+#include <map>
+
+using namespace cocaine::io;
+
+namespace {
+
+typedef streaming<boost::mpl::list<std::string>::type>::chunk chunk_type;
+
+} // namespace
+
+TEST_F(stream_pair_test, drains_after_overflow) {
+    stream->limit(65536);
+
+    const std::string payload(4096, 'x');
+
+    // Nobody reads from the client side, so the outbound queue grows once the socket buffer is full.
+    while(!stream->overloaded()) {
+        stream->write(encoded<chunk_type>(1, payload));
+    }
+
+    bool drained = false;
+
+    stream->drained([&] { drained = true; });
+
+    reactor.poll();
+    ASSERT_FALSE(drained);
+
+    while(!drained) {
+        receive();
+    }
+
+    ASSERT_LE(stream->pressure(), stream->limit() / 2);
+}
+
+TEST_F(stream_pair_test, interleaves_large_messages) {
+    stream->interleave(4096);
+
+    const std::string large(1 << 20, 'x');
+
+    stream->write(encoded<chunk_type>(1, large));
+    stream->write(encoded<chunk_type>(2, std::string("small")));
+
+    std::string received;
+
+    while(stream->pressure()) {
+        const size_t size = receive();
+        received.append(sink.data(), size);
+    }
+
+    decoder_t decoder, reassembler;
+    decoder_t::message_type message;
+
+    std::map<uint64_t, std::string> streams;
+    std::vector<uint64_t> completed;
+
+    for(size_t offset = 0; offset < received.size();) {
+        std::error_code ec;
+
+        offset += decoder.decode(received.data() + offset, received.size() - offset, message, ec);
+        ASSERT_FALSE(ec);
+
+        if(message.span() != 0) {
+            completed.push_back(message.span());
+            continue;
+        }
+
+        ASSERT_EQ(event_traits<control::fragment>::id, message.type());
+
+        const auto& args = message.args().via.array;
+        auto& pieces = streams[args.ptr[0].as<uint64_t>()];
+
+        pieces += args.ptr[2].as<std::string>();
+
+        if(!args.ptr[1].as<bool>()) {
+            continue;
+        }
+
+        reassembler.decode(pieces.data(), pieces.size(), message, ec);
+        ASSERT_FALSE(ec);
+
+        ASSERT_EQ(large, message.args().via.array.ptr[0].as<std::string>());
+        completed.push_back(message.span());
+    }
+
+    // The small message doesn't wait for the large one written before it.
+    ASSERT_EQ((std::vector<uint64_t>{2, 1}), completed);
+}
+
+TEST_F(stream_pair_test, coalesces_writes_within_a_turn) {
+    const auto stats = std::make_shared<outbound_stats_t>();
+
+    stream->coalesce(65536);
+    stream->stats(stats);
+
+    for(size_t i = 0; i < 50; ++i) {
+        stream->write(encoded<chunk_type>(1, std::string("chunk")));
+    }
+
+    ASSERT_EQ(0u, stream->writes());
+
+    reactor.poll();
+
+    EXPECT_EQ(1u, stream->writes());
+    EXPECT_EQ(50u, stats->messages.load());
+    EXPECT_EQ(1u, stats->writes.load());
+    EXPECT_EQ(0u, stream->pressure());
+}